@@ -0,0 +1,565 @@
+#include "ProjConvertor.h"
+#include "DirWalker.h"
+#include "SemicolonList.h"
+#include "XmlStream.h"
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+#ifdef _WIN32
+#include <windows.h>
+#include <psapi.h>
+#pragma comment(lib, "psapi.lib")
+#else
+#include <sys/resource.h>
+#endif
+
+//Benchmark for the conversion phases. For every scale it generates a synthetic CMake-style
+//project (source tree, .vcxproj, .vcxproj.filters and config.xml), converts it and reports
+//the time of ReadConfig, BuildVCXPROJ and BuildFilter separately. BuildVCXPROJ is run a second
+//time with the io_uring copy backend to compare it with the synchronous copies.
+//--check instead runs the checks of the helpers the conversion is built on: the streaming XML
+//classes against the property_tree code they replaced, on the sample config and on a generated
+//project before and after conversion, and the path, list and glob helpers. It prints what
+//failed and exits with 1 when anything did.
+
+namespace
+{
+	class	SBenchOptions
+	{
+	public:
+		std::vector<size_t>	Scales_;
+		size_t		Configs_ = 4;
+		size_t		SrcDirs_ = 4;
+		bfs::path	WorkDir_ = "bench";
+		bool		Check_ = false;
+		std::vector<bfs::path>	XmlFiles_;	//--check: the sample configs, config.xml by default.
+	};
+
+	//Peak resident set size of the process so far, in bytes.
+	size_t	GetPeakRSS()
+	{
+#ifdef _WIN32
+		PROCESS_MEMORY_COUNTERS counters;
+		if ( GetProcessMemoryInfo(GetCurrentProcess(), &counters, sizeof(counters)) )
+		{
+			return counters.PeakWorkingSetSize;
+		}
+		return 0;
+#else
+		struct rusage usage;
+		if ( getrusage(RUSAGE_SELF, &usage) != 0 )
+		{
+			return 0;
+		}
+#ifdef __APPLE__
+		return static_cast<size_t>(usage.ru_maxrss);
+#else
+		return static_cast<size_t>(usage.ru_maxrss) * 1024;
+#endif
+#endif
+	}
+
+	std::string	ConfigName(size_t index)
+	{
+		static const char* sNames[] = { "Debug", "Release", "MinSizeRel", "RelWithDebInfo" };
+		if ( index < 4 )
+		{
+			return sNames[index];
+		}
+
+		std::ostringstream oss;
+		oss << "Config" << index;
+		return oss.str();
+	}
+
+	//Writes itemCount source files (half .cpp, half .h) spread over SrcDirs_ source roots and
+	//the .vcxproj/.filters pair CMake would generate for them.
+	void	GenerateProject(const bfs::path& root, size_t itemCount, const SBenchOptions& options)
+	{
+		auto srcRoot = root / "src";
+		auto buildDir = root / "build";
+		bfs::create_directories(buildDir);
+
+		std::vector<bfs::path> sources, headers;
+		for ( size_t index = 0; index < itemCount; ++index )
+		{
+			std::ostringstream dirName, fileName;
+			dirName << "dir" << (index % options.SrcDirs_);
+			fileName << "file" << (index / 2) << ((index % 2) == 0 ? ".cpp" : ".h");
+
+			//Sub directories of at most 200 files, like a real source tree.
+			std::ostringstream subName;
+			subName << "sub" << (index / options.SrcDirs_ / 200);
+
+			auto dir = srcRoot / dirName.str() / subName.str();
+			auto file = dir / fileName.str();
+			if ( !bfs::exists(dir) )
+			{
+				bfs::create_directories(dir);
+			}
+
+			bfs::ofstream ofs(file, std::ios::trunc | std::ios::out);
+			ofs << "//" << fileName.str() << "\nint f" << index << "() { return " << index << "; }\n";
+
+			((index % 2) == 0 ? sources : headers).push_back(file);
+		}
+
+		std::string condition = "'$(Configuration)|$(Platform)'=='";
+
+		bfs::ofstream vcx(buildDir / "bench.vcxproj", std::ios::trunc | std::ios::out);
+		vcx << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+		vcx << "<Project DefaultTargets=\"Build\" ToolsVersion=\"12.0\" xmlns=\"http://schemas.microsoft.com/developer/msbuild/2003\">\n";
+		vcx << "  <ItemGroup Label=\"ProjectConfigurations\">\n";
+		for ( size_t index = 0; index < options.Configs_; ++index )
+		{
+			auto name = ConfigName(index);
+			vcx << "    <ProjectConfiguration Include=\"" << name << "|Win32\">\n";
+			vcx << "      <Configuration>" << name << "</Configuration>\n";
+			vcx << "      <Platform>Win32</Platform>\n";
+			vcx << "    </ProjectConfiguration>\n";
+		}
+		vcx << "  </ItemGroup>\n";
+		vcx << "  <PropertyGroup>\n";
+		for ( size_t index = 0; index < options.Configs_; ++index )
+		{
+			auto name = ConfigName(index);
+			vcx << "    <OutDir Condition=\"" << condition << name << "|Win32'\">" << (buildDir / name).string() << "</OutDir>\n";
+			vcx << "    <IntDir Condition=\"" << condition << name << "|Win32'\">bench.dir/" << name << "/</IntDir>\n";
+			vcx << "    <TargetName Condition=\"" << condition << name << "|Win32'\">bench</TargetName>\n";
+		}
+		vcx << "  </PropertyGroup>\n";
+		for ( size_t index = 0; index < options.Configs_; ++index )
+		{
+			auto name = ConfigName(index);
+			vcx << "  <ItemDefinitionGroup Condition=\"" << condition << name << "|Win32'\">\n";
+			vcx << "    <ClCompile>\n";
+			vcx << "      <AdditionalIncludeDirectories>" << srcRoot.string() << ";%(AdditionalIncludeDirectories)</AdditionalIncludeDirectories>\n";
+			vcx << "      <AssemblerListingLocation>" << name << "/</AssemblerListingLocation>\n";
+			vcx << "      <PreprocessorDefinitions>WIN32;_WINDOWS;NDEBUG;BENCH_A=1;BENCH_B;CMAKE_INTDIR=\"" << name << "\";%(PreprocessorDefinitions)</PreprocessorDefinitions>\n";
+			vcx << "      <ProgramDataBaseFile>bench.pdb</ProgramDataBaseFile>\n";
+			vcx << "    </ClCompile>\n";
+			vcx << "    <Link>\n";
+			vcx << "      <AdditionalDependencies>kernel32.lib;user32.lib;gdi32.lib</AdditionalDependencies>\n";
+			vcx << "      <ImportLibrary>" << (buildDir / name / "bench.lib").string() << "</ImportLibrary>\n";
+			vcx << "    </Link>\n";
+			vcx << "  </ItemDefinitionGroup>\n";
+		}
+		vcx << "  <ItemGroup>\n";
+		for ( auto& curFile : headers )
+		{
+			vcx << "    <ClInclude Include=\"" << curFile.string() << "\" />\n";
+		}
+		for ( auto& curFile : sources )
+		{
+			vcx << "    <ClCompile Include=\"" << curFile.string() << "\" />\n";
+		}
+		vcx << "  </ItemGroup>\n";
+		vcx << "  <Import Project=\"$(VCTargetsPath)\\Microsoft.Cpp.targets\" />\n";
+		vcx << "</Project>\n";
+
+		bfs::ofstream filters(buildDir / "bench.vcxproj.filters", std::ios::trunc | std::ios::out);
+		filters << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+		filters << "<Project ToolsVersion=\"4.0\" xmlns=\"http://schemas.microsoft.com/developer/msbuild/2003\">\n";
+		filters << "  <ItemGroup>\n";
+		for ( auto& curFile : sources )
+		{
+			filters << "    <ClCompile Include=\"" << curFile.string() << "\">\n      <Filter>Source Files</Filter>\n    </ClCompile>\n";
+		}
+		for ( auto& curFile : headers )
+		{
+			filters << "    <ClInclude Include=\"" << curFile.string() << "\">\n      <Filter>Header Files</Filter>\n    </ClInclude>\n";
+		}
+		filters << "  </ItemGroup>\n";
+		filters << "  <ItemGroup>\n";
+		filters << "    <Filter Include=\"Source Files\">\n      <UniqueIdentifier>{4FC737F1-C7A5-4376-A066-2A32D752A2FF}</UniqueIdentifier>\n    </Filter>\n";
+		filters << "    <Filter Include=\"Header Files\">\n      <UniqueIdentifier>{93995380-89BD-4b04-88EB-625FBE52EBFB}</UniqueIdentifier>\n    </Filter>\n";
+		filters << "  </ItemGroup>\n";
+		filters << "</Project>\n";
+
+		auto outDir = root / "out";
+
+		bfs::ofstream cfg(root / "config.xml", std::ios::trunc | std::ios::out);
+		cfg << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+		cfg << "<Project TargetName=\"bench\">\n";
+		cfg << "\t<ProjectBuildPath Path=\"" << outDir.string() << "\" />\n";
+		cfg << "\t<VCXProjectPath From=\"" << buildDir.string() << "\" To=\"" << (outDir / "proj").string() << "\" />\n";
+		cfg << "\t<SrcDirectories>\n";
+		for ( size_t index = 0; index < options.SrcDirs_; ++index )
+		{
+			cfg << "\t\t<Item From=\"" << (srcRoot / ("dir" + std::to_string(index))).string() << "\" To=\"" << (outDir / "src" / ("dir" + std::to_string(index))).string() << "\" AddToIncludeDir=\"True\" />\n";
+		}
+		cfg << "\t</SrcDirectories>\n";
+		cfg << "\t<IgnoreCustomBuild All=\"True\" />\n";
+		cfg << "\t<AdditionalIncludeDirectories>\n\t\t<Item Path=\"include\" />\n\t</AdditionalIncludeDirectories>\n";
+		cfg << "</Project>\n";
+	}
+
+	class	SPhaseResult
+	{
+	public:
+		const char*	Name_ = "";
+		double		Seconds_ = 0;
+		size_t		PeakRSS_ = 0;
+	};
+
+	void	PrintResult(size_t itemCount, const SPhaseResult& result)
+	{
+		auto filesPerSec = result.Seconds_ > 0 ? itemCount / result.Seconds_ : 0;
+
+		std::cout << std::left << std::setw(10) << itemCount << std::setw(26) << result.Name_ << std::right
+			<< std::fixed << std::setprecision(3) << std::setw(10) << result.Seconds_ << " s"
+			<< std::setprecision(0) << std::setw(14) << filesPerSec << " files/s"
+			<< std::setprecision(1) << std::setw(10) << result.PeakRSS_ / (1024.0 * 1024.0) << " MB" << std::endl;
+	}
+
+	template<typename Func>
+	SPhaseResult	TimePhase(const char* name, Func func, bool& ok)
+	{
+		SPhaseResult result;
+		result.Name_ = name;
+
+		auto start = std::chrono::steady_clock::now();
+		ok = func();
+		result.Seconds_ = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+		result.PeakRSS_ = GetPeakRSS();
+
+		return result;
+	}
+
+	bool	RunScale(size_t itemCount, const SBenchOptions& options)
+	{
+		auto root = bfs::system_complete(options.WorkDir_ / std::to_string(itemCount));
+		bfs::remove_all(root);
+
+		std::cout << "Generating " << itemCount << " items in " << root << std::endl;
+		GenerateProject(root, itemCount, options);
+
+		ProjectList projList;
+		bool ok = false;
+
+		auto readResult = TimePhase("ReadConfig", [&]()
+		{
+			projList = ReadConfig(root / "config.xml");
+			return projList.size() == 1;
+		}, ok);
+		if ( !ok )
+		{
+			return false;
+		}
+
+		auto& projInfo = projList.front();
+		ResolutionTable table;
+
+		auto vcxResult = TimePhase("BuildVCXPROJ", [&]() { return BuildVCXPROJ(projInfo, table); }, ok);
+		if ( !ok )
+		{
+			return false;
+		}
+
+		auto filterResult = TimePhase("BuildFilter", [&]() { return BuildFilter(projInfo, table); }, ok);
+		if ( !ok )
+		{
+			return false;
+		}
+
+		//The same conversion again with the io_uring copy backend, into an empty output.
+		bfs::remove_all(root / "out");
+		projInfo.UseIoUring = true;
+		ResolutionTable uringTable;
+
+		auto uringResult = TimePhase("BuildVCXPROJ (io_uring)", [&]() { return BuildVCXPROJ(projInfo, uringTable); }, ok);
+		if ( !ok )
+		{
+			return false;
+		}
+
+		PrintResult(itemCount, readResult);
+		PrintResult(itemCount, vcxResult);
+		PrintResult(itemCount, uringResult);
+		PrintResult(itemCount, filterResult);
+
+		return true;
+	}
+
+	class	SChecker
+	{
+	public:
+
+		void	Expect(bool passed, const std::string& what)
+		{
+			++Count_;
+			if ( !passed )
+			{
+				++Failed_;
+				std::cerr << "FAILED: " << what << std::endl;
+			}
+		}
+
+		size_t		Count_ = 0;
+		size_t		Failed_ = 0;
+	};
+
+	//text with the separators PathTable writes.
+	std::string	Native(std::string text)
+	{
+#ifdef _WIN32
+		std::replace(text.begin(), text.end(), '/', '\\');
+#endif
+		return text;
+	}
+
+	//An XmlDocument node in the layout read_xml produces.
+	ptree	ToPtree(const XmlDocument::SNode& node)
+	{
+		ptree ret(node.Value_.str());
+
+		if ( node.FirstAttribute_ )
+		{
+			ptree attributes;
+			for ( auto curAttr = node.FirstAttribute_; curAttr; curAttr = curAttr->Next_ )
+			{
+				attributes.push_back(std::make_pair(curAttr->Name_.str(), ptree(curAttr->Value_.str())));
+			}
+			ret.push_back(std::make_pair("<xmlattr>", attributes));
+		}
+
+		for ( auto curChild = node.FirstChild_; curChild; curChild = curChild->Next_ )
+		{
+			ret.push_back(std::make_pair(curChild->Name_.str(), ToPtree(*curChild)));
+		}
+
+		return ret;
+	}
+
+	//Reads file with read_xml, XmlReader and XmlDocument and expects the same tree from all
+	//three, then writes it with write_xml and XmlWriter and expects the same bytes.
+	void	CheckXml(SChecker& checker, const bfs::path& file)
+	{
+		auto name = file.string();
+
+		ptree expected;
+		{
+			bfs::ifstream ifs(file);
+			xml_parser::read_xml(ifs, expected, xml_parser::no_comments | xml_parser::trim_whitespace);
+		}
+
+		//Element by element, as BuildVCXPROJ reads.
+		ptree streamed;
+		{
+			bfs::ifstream ifs(file);
+			XmlReader reader(ifs, name);
+			while ( reader.NextChild() )
+			{
+				auto elementName = reader.GetName();
+				ptree element;
+				reader.ReadElement(element);
+				streamed.push_back(std::make_pair(elementName, element));
+			}
+		}
+		checker.Expect(streamed == expected, "XmlReader reads " + name + " as read_xml does");
+
+		XmlDocument document;
+		document.Load(file);
+		checker.Expect(ToPtree(document.GetRoot()) == expected, "XmlDocument reads " + name + " as read_xml does");
+
+		std::ostringstream dom;
+		xml_parser::write_xml(dom, expected, xml_parser::xml_writer_settings<std::string>(' ', 2));
+
+		//The top-level element opened and closed around its children, as BuildVCXPROJ writes.
+		std::ostringstream stream;
+		XmlWriter writer(stream, 2);
+		writer.WriteDeclaration();
+		for ( auto& curTop : expected )
+		{
+			writer.StartElement(curTop.first, curTop.second.get_child("<xmlattr>", ptree()));
+			for ( auto& curChild : curTop.second )
+			{
+				if ( curChild.first != "<xmlattr>" )
+				{
+					writer.WriteElement(curChild.first, curChild.second);
+				}
+			}
+			writer.EndElement();
+		}
+		checker.Expect(stream.str() == dom.str(), "XmlWriter writes " + name + " as write_xml does");
+	}
+
+	void	CheckPaths(SChecker& checker)
+	{
+		auto& paths = PathTable::GetInstance();
+
+		checker.Expect(paths.Intern("/a/b/../c/./d") == paths.Intern("/a/c/d"), "PathTable resolves . and ..");
+		checker.Expect(paths.Intern("/a//c\\d/") == paths.Intern("/a/c/d"), "PathTable takes both separators and drops empty components");
+		checker.Expect(paths.Intern("x/../..") == paths.Intern(".."), "PathTable keeps a leading ..");
+		checker.Expect(paths.Intern(paths.Intern("/a/b"), "c/../d") == paths.Intern("/a/b/d"), "PathTable resolves text against a base");
+		checker.Expect(paths.Intern(paths.Intern("/a/b"), "/x") == paths.Intern("/x"), "PathTable ignores the base of absolute text");
+		checker.Expect(paths.ToString(paths.Intern("/a/b")) == Native("/a/b"), "PathTable::ToString");
+		checker.Expect(paths.IsWithin(paths.Intern("/a/b/c"), paths.Intern("/a/b")), "PathTable::IsWithin below");
+		checker.Expect(!paths.IsWithin(paths.Intern("/a/bc"), paths.Intern("/a/b")), "PathTable::IsWithin sibling");
+		checker.Expect(paths.Relative(paths.Intern("/a/b"), paths.Intern("/a/c/d")) == Native("../c/d"), "PathTable::Relative up and down");
+		checker.Expect(paths.Relative(paths.Intern("/a"), paths.Intern("/a/b")) == "b", "PathTable::Relative down");
+		checker.Expect(paths.Relative(paths.Intern("/a/b"), paths.Intern("/a/b")).empty(), "PathTable::Relative to itself");
+		checker.Expect(paths.Rebase(paths.Intern("/s/x/y.h"), paths.Intern("/s"), paths.Intern("/t")) == paths.Intern("/t/x/y.h"), "PathTable::Rebase");
+
+		//What the solution, watch and archive code compare paths with.
+		checker.Expect(paths.Intern(paths.Intern("/sln"), "build/./p.vcxproj") == paths.Intern("/sln/build/p.vcxproj"), "PathTable matches a .sln project path");
+		checker.Expect(paths.IsWithin(paths.Intern("/a"), PathTable::sEmpty) && paths.ToString(PathTable::sEmpty).empty(), "PathTable::sEmpty holds every path");
+		checker.Expect(paths.ToString(paths.Intern("/")) == Native("/"), "PathTable::ToString of the root");
+#ifdef _WIN32
+		checker.Expect(paths.Intern("C:\\A\\b") == paths.Intern("c:/a/B"), "PathTable folds case and drive letters");
+		checker.Expect(paths.Intern("d:\\code\\p.vcxproj") == paths.Intern("D:/Code/./p.vcxproj"), "PathTable matches a .sln path spelled in another case");
+		checker.Expect(paths.Relative(paths.Intern("C:/a"), paths.Intern("D:/b")) == "D:\\b", "PathTable::Relative across drives");
+#else
+		checker.Expect(paths.Intern("C:/a") != paths.Intern("/a") && paths.ToString(paths.Intern("C:/a")) == "C:/a", "PathTable treats C: as a name");
+#endif
+	}
+
+	void	CheckSemicolonLists(SChecker& checker)
+	{
+		SemicolonList list(" A; B ;;A;%(B)");
+		checker.Expect(list.Join() == "A;B;%(B)", "SemicolonList trims and drops empty and repeated items");
+		checker.Expect(!list.Add("") && !list.Add("B") && list.Add("C"), "SemicolonList::Add");
+		checker.Expect(list.GetItems().size() == 4 && list.GetItems().back() == "C", "SemicolonList keeps the first-seen order");
+		checker.Expect(SemicolonList("").Join().empty(), "SemicolonList of nothing");
+
+		list.Append("D; A;\tE\t");
+		checker.Expect(list.Join() == "A;B;%(B);C;D;E", "SemicolonList::Append keeps the items already listed");
+	}
+
+	void	CheckGlobs(SChecker& checker)
+	{
+		checker.Expect(DirWalker::MatchGlob("*.h", "a.h"), "MatchGlob *");
+		checker.Expect(!DirWalker::MatchGlob("*.h", "a.hpp"), "MatchGlob * to the end");
+		checker.Expect(!DirWalker::MatchGlob("*.h", "d/a.h"), "MatchGlob * stops at /");
+		checker.Expect(DirWalker::MatchGlob("d/*.h", "d/a.h"), "MatchGlob with a directory");
+		checker.Expect(DirWalker::MatchGlob("**/*.h", "d/e/a.h"), "MatchGlob ** crosses /");
+		checker.Expect(DirWalker::MatchGlob("a?c", "abc") && !DirWalker::MatchGlob("a?c", "a/c"), "MatchGlob ?");
+		checker.Expect(DirWalker::MatchGlob("**/*.h", "a.h"), "MatchGlob **/ matches no directory");
+		checker.Expect(!DirWalker::MatchGlob("CMakeFiles", "CMakeFiles2"), "MatchGlob without wildcards");
+	}
+
+	bool	RunChecks(const SBenchOptions& options)
+	{
+		SChecker checker;
+
+		try
+		{
+			CheckPaths(checker);
+			CheckSemicolonLists(checker);
+			CheckGlobs(checker);
+
+			auto xmlFiles = options.XmlFiles_;
+			if ( xmlFiles.empty() )
+			{
+				if ( bfs::exists("config.xml") )
+				{
+					xmlFiles.push_back("config.xml");
+				}
+				else
+				{
+					std::cout << "No config.xml here, only the generated project is checked." << std::endl;
+				}
+			}
+			for ( auto& curFile : xmlFiles )
+			{
+				CheckXml(checker, curFile);
+			}
+
+			//A generated project, and what the conversion made of it.
+			auto root = bfs::system_complete(options.WorkDir_ / "check");
+			bfs::remove_all(root);
+			GenerateProject(root, 40, options);
+
+			auto projList = ReadConfig(root / "config.xml");
+			checker.Expect(projList.size() == 1, "ReadConfig of the generated config");
+			if ( projList.size() == 1 )
+			{
+				ResolutionTable table;
+				checker.Expect(BuildVCXPROJ(projList.front(), table) && BuildFilter(projList.front(), table), "Converting the generated project");
+
+				for ( auto curFile : { root / "config.xml", root / "build" / "bench.vcxproj", root / "build" / "bench.vcxproj.filters",
+					root / "out" / "proj" / "bench.vcxproj", root / "out" / "proj" / "bench.vcxproj.filters" } )
+				{
+					CheckXml(checker, curFile);
+				}
+			}
+		}
+		catch ( std::exception& exp )
+		{
+			checker.Expect(false, exp.what());
+		}
+
+		std::cout << checker.Count_ - checker.Failed_ << " of " << checker.Count_ << " checks passed." << std::endl;
+		return checker.Failed_ == 0;
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	SBenchOptions options;
+
+	for ( int index = 1; index < argc; ++index )
+	{
+		auto hasValue = index + 1 < argc;
+
+		if ( std::strcmp(argv[index], "--scale") == 0 && hasValue )
+		{
+			options.Scales_.push_back(static_cast<size_t>(std::atol(argv[++index])));
+		}
+		else if ( std::strcmp(argv[index], "--configs") == 0 && hasValue )
+		{
+			options.Configs_ = std::max<size_t>(1, std::atol(argv[++index]));
+		}
+		else if ( std::strcmp(argv[index], "--srcdirs") == 0 && hasValue )
+		{
+			options.SrcDirs_ = std::max<size_t>(1, std::atol(argv[++index]));
+		}
+		else if ( std::strcmp(argv[index], "--work") == 0 && hasValue )
+		{
+			options.WorkDir_ = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--check") == 0 )
+		{
+			options.Check_ = true;
+		}
+		else if ( std::strcmp(argv[index], "--xml") == 0 && hasValue )
+		{
+			options.XmlFiles_.push_back(argv[++index]);
+		}
+		else
+		{
+			std::cerr << "Unknown option " << argv[index] << std::endl;
+			std::cerr << "Usage: ProjConvertorBench [--scale N]... [--configs N] [--srcdirs N] [--work DIR] [--check [--xml FILE]...]" << std::endl;
+			return 1;
+		}
+	}
+
+	if ( options.Check_ )
+	{
+		return RunChecks(options) ? 0 : 1;
+	}
+
+	if ( options.Scales_.empty() )
+	{
+		options.Scales_ = { 1000, 10000, 100000 };
+	}
+
+	for ( auto curScale : options.Scales_ )
+	{
+		if ( !RunScale(curScale, options) )
+		{
+			std::cerr << "Benchmark failed at " << curScale << " items." << std::endl;
+			return 1;
+		}
+	}
+
+	return 0;
+}
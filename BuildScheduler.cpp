@@ -0,0 +1,243 @@
+#include "BuildScheduler.h"
+
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <sstream>
+#include <thread>
+
+namespace
+{
+	enum class EState
+	{
+		Waiting,
+		Running,
+		Succeeded,
+		Failed,
+		Skipped,
+	};
+
+	class	SJob
+	{
+	public:
+		const SProjectInfo*	Project_ = nullptr;
+		std::vector<size_t>	Dependents_;
+		size_t		PendingCount_ = 0;
+		EState		State_ = EState::Waiting;
+		std::string	Reason_;
+		double		Seconds_ = 0;
+	};
+}
+
+unsigned GetCopyJobShare(unsigned jobCount, size_t projectCount)
+{
+	auto cores = std::max(1u, std::thread::hardware_concurrency());
+	if ( jobCount == 0 )
+	{
+		jobCount = cores;
+	}
+
+	auto concurrent = std::max<size_t>(1, std::min<size_t>(jobCount, projectCount));
+	return std::max(1u, static_cast<unsigned>(cores / concurrent));
+}
+
+bool BuildProjects(const ProjectList& projList, unsigned jobCount, std::vector<ResolutionTable>* tables)
+{
+	std::vector<SJob> jobs(projList.size());
+
+	if ( tables )
+	{
+		tables->assign(projList.size(), ResolutionTable());
+	}
+
+	{//Dependencies between the listed projects.
+		std::map<std::string, size_t> byName;
+		for ( size_t index = 0; index < projList.size(); ++index )
+		{
+			jobs[index].Project_ = &projList[index];
+			byName.emplace(projList[index].TargetName, index);
+		}
+
+		for ( size_t index = 0; index < projList.size(); ++index )
+		{
+			auto depends = projList[index].DependsOn;
+			std::vector<std::string> references;
+			{
+				PhaseTimer timer(projList[index].Report, ProjectReport::EPhase::ReadReferences);
+				references = ReadProjectReferences(projList[index]);
+			}
+			depends.insert(depends.end(), references.begin(), references.end());
+
+			std::sort(depends.begin(), depends.end());
+			depends.erase(std::unique(depends.begin(), depends.end()), depends.end());
+
+			for ( auto& curDep : depends )
+			{
+				auto itor = byName.find(curDep);
+				if ( itor == byName.end() || itor->second == index )
+				{
+					continue;
+				}
+
+				jobs[itor->second].Dependents_.push_back(index);
+				++jobs[index].PendingCount_;
+			}
+		}
+	}
+
+	std::mutex mutex;
+	std::condition_variable cond;
+	std::deque<size_t> ready;
+	size_t running = 0;
+
+	for ( size_t index = 0; index < jobs.size(); ++index )
+	{
+		if ( jobs[index].PendingCount_ == 0 )
+		{
+			ready.push_back(index);
+		}
+	}
+
+	//Called with mutex held.
+	std::function<void(size_t, const std::string&)> skipDependents = [&](size_t index, const std::string& reason)
+	{
+		for ( auto curDep : jobs[index].Dependents_ )
+		{
+			if ( jobs[curDep].State_ != EState::Waiting )
+			{
+				continue;
+			}
+
+			jobs[curDep].State_ = EState::Skipped;
+			jobs[curDep].Reason_ = reason;
+			skipDependents(curDep, reason);
+		}
+	};
+
+	auto worker = [&]()
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		for ( ;; )
+		{
+			//Nothing ready and nothing running means no other project can become ready.
+			cond.wait(lock, [&]() { return !ready.empty() || running == 0; });
+			if ( ready.empty() )
+			{
+				break;
+			}
+
+			auto index = ready.front();
+			ready.pop_front();
+
+			auto& curJob = jobs[index];
+			curJob.State_ = EState::Running;
+			++running;
+			lock.unlock();
+
+			auto succeeded = false;
+			std::string reason;
+			auto start = std::chrono::steady_clock::now();
+			try
+			{
+				succeeded = tables ? BuildProject(*curJob.Project_, (*tables)[index]) : BuildProject(*curJob.Project_);
+			}
+			catch ( std::exception& exp )
+			{
+				reason = exp.what();
+			}
+			auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+			lock.lock();
+			curJob.Seconds_ = seconds;
+			curJob.State_ = succeeded ? EState::Succeeded : EState::Failed;
+			curJob.Reason_ = reason;
+			--running;
+
+			if ( succeeded )
+			{
+				for ( auto curDep : curJob.Dependents_ )
+				{
+					if ( --jobs[curDep].PendingCount_ == 0 && jobs[curDep].State_ == EState::Waiting )
+					{
+						ready.push_back(curDep);
+					}
+				}
+			}
+			else
+			{
+				skipDependents(index, "depends on " + curJob.Project_->TargetName);
+			}
+
+			cond.notify_all();
+		}
+	};
+
+	if ( jobCount == 0 )
+	{
+		jobCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+	auto threadCount = std::min<size_t>(jobCount, jobs.size());
+
+	std::vector<std::thread> threads;
+	for ( size_t index = 1; index < threadCount; ++index )
+	{
+		threads.emplace_back(worker);
+	}
+	if ( threadCount > 0 )
+	{
+		worker();
+	}
+
+	for ( auto& curThread : threads )
+	{
+		curThread.join();
+	}
+
+	//Projects still waiting here are part of a dependency cycle.
+	auto allSucceeded = true;
+	std::cout << "Summary:" << std::endl;
+	for ( auto& curJob : jobs )
+	{
+		if ( curJob.State_ == EState::Waiting )
+		{
+			curJob.State_ = EState::Skipped;
+			curJob.Reason_ = "dependency cycle";
+		}
+
+		const char* state = "";
+		switch ( curJob.State_ )
+		{
+		case EState::Succeeded:	state = "OK"; break;
+		case EState::Failed:	state = "FAILED"; break;
+		default:				state = "SKIPPED"; break;
+		}
+
+		allSucceeded = allSucceeded && curJob.State_ == EState::Succeeded;
+
+		if ( curJob.Project_->Report )
+		{
+			curJob.Project_->Report->SetResult(state, curJob.Seconds_, curJob.Reason_);
+		}
+
+		//Formatted apart, so std::cout keeps its flags.
+		std::ostringstream oss;
+		oss << "  " << std::left << std::setw(24) << curJob.Project_->TargetName << std::setw(9) << state;
+		if ( curJob.State_ != EState::Skipped )
+		{
+			oss << std::fixed << std::setprecision(2) << curJob.Seconds_ << "s";
+		}
+		if ( !curJob.Reason_.empty() )
+		{
+			oss << " (" << curJob.Reason_ << ")";
+		}
+		std::cout << oss.str() << std::endl;
+	}
+
+	return allSucceeded;
+}
@@ -0,0 +1,14 @@
+#pragma once
+
+#include "ProjConvertor.h"
+
+//Converts the projects in parallel, starting a project only after the projects it depends on
+//have been converted. A failed project only stops the projects that depend on it. Prints a
+//per-project summary and returns true when every project was converted.
+//jobCount == 0 means one job per hardware thread. tables, when given, receives the resolution
+//table of every project, in projList order.
+bool	BuildProjects(const ProjectList& projList, unsigned jobCount, std::vector<ResolutionTable>* tables = nullptr);
+
+//The copy threads each project gets when jobCount projects convert at once (0 as above), so
+//that all of them together start about one per hardware thread. At least 1.
+unsigned	GetCopyJobShare(unsigned jobCount, size_t projectCount);
@@ -0,0 +1,215 @@
+#include "ContentStore.h"
+#include "MappedFile.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <set>
+#include <sstream>
+#include <vector>
+
+namespace
+{
+	const std::uint64_t	sPrime1 = 11400714785074694791ULL;
+	const std::uint64_t	sPrime2 = 14029467366897019727ULL;
+	const std::uint64_t	sPrime3 = 1609587929392839161ULL;
+	const std::uint64_t	sPrime4 = 9650029242287828579ULL;
+	const std::uint64_t	sPrime5 = 2870177450012600261ULL;
+
+	inline	std::uint64_t	Rotl(std::uint64_t value, int bits)
+	{
+		return (value << bits) | (value >> (64 - bits));
+	}
+
+	//XXH64 is defined on little-endian reads, which is what every target of this tool does.
+	inline	std::uint64_t	Read64(const unsigned char* ptr)
+	{
+		std::uint64_t ret;
+		std::memcpy(&ret, ptr, sizeof(ret));
+		return ret;
+	}
+
+	inline	std::uint32_t	Read32(const unsigned char* ptr)
+	{
+		std::uint32_t ret;
+		std::memcpy(&ret, ptr, sizeof(ret));
+		return ret;
+	}
+
+	inline	std::uint64_t	Round(std::uint64_t acc, std::uint64_t input)
+	{
+		acc += input * sPrime2;
+		acc = Rotl(acc, 31);
+		return acc * sPrime1;
+	}
+
+	inline	std::uint64_t	MergeRound(std::uint64_t acc, std::uint64_t value)
+	{
+		acc ^= Round(0, value);
+		return acc * sPrime1 + sPrime4;
+	}
+}
+
+std::uint64_t ContentStore::Hash(const void* data, size_t size, std::uint64_t seed)
+{
+	auto ptr = static_cast<const unsigned char*>(data);
+	auto end = ptr + size;
+
+	std::uint64_t ret;
+	if ( size >= 32 )
+	{
+		auto v1 = seed + sPrime1 + sPrime2;
+		auto v2 = seed + sPrime2;
+		auto v3 = seed;
+		auto v4 = seed - sPrime1;
+
+		do
+		{
+			v1 = Round(v1, Read64(ptr));
+			v2 = Round(v2, Read64(ptr + 8));
+			v3 = Round(v3, Read64(ptr + 16));
+			v4 = Round(v4, Read64(ptr + 24));
+			ptr += 32;
+		} while ( ptr + 32 <= end );
+
+		ret = Rotl(v1, 1) + Rotl(v2, 7) + Rotl(v3, 12) + Rotl(v4, 18);
+		ret = MergeRound(ret, v1);
+		ret = MergeRound(ret, v2);
+		ret = MergeRound(ret, v3);
+		ret = MergeRound(ret, v4);
+	}
+	else
+	{
+		ret = seed + sPrime5;
+	}
+
+	ret += size;
+
+	for ( ; ptr + 8 <= end; ptr += 8 )
+	{
+		ret ^= Round(0, Read64(ptr));
+		ret = Rotl(ret, 27) * sPrime1 + sPrime4;
+	}
+
+	if ( ptr + 4 <= end )
+	{
+		ret ^= static_cast<std::uint64_t>(Read32(ptr)) * sPrime1;
+		ret = Rotl(ret, 23) * sPrime2 + sPrime3;
+		ptr += 4;
+	}
+
+	for ( ; ptr < end; ++ptr )
+	{
+		ret ^= *ptr * sPrime5;
+		ret = Rotl(ret, 11) * sPrime1;
+	}
+
+	ret ^= ret >> 33;
+	ret *= sPrime2;
+	ret ^= ret >> 29;
+	ret *= sPrime3;
+	ret ^= ret >> 32;
+	return ret;
+}
+
+bfs::path ContentStore::Put(const bfs::path& file) const
+{
+	MappedFile contents;
+	if ( !contents.Open(file) )
+	{
+		throw bfs::filesystem_error("Can not read", file, boost::system::errc::make_error_code(boost::system::errc::io_error));
+	}
+
+	//objects/ab/cdef0123456789-size: the first byte of the hash fans the objects out.
+	std::ostringstream oss;
+	oss << std::hex << std::setw(16) << std::setfill('0') << Hash(contents.GetData(), contents.GetSize());
+	auto name = oss.str();
+	auto object = Root_ / "objects" / name.substr(0, 2) / (name.substr(2) + "-" + std::to_string(static_cast<unsigned long long>(contents.GetSize())));
+
+	boost::system::error_code ec;
+	if ( bfs::exists(object, ec) )
+	{
+		return object;
+	}
+
+	bfs::create_directories(object.parent_path());
+
+	//Written under a unique name and renamed into place, so no one links to a partial object.
+	//Another writer may win the race for the same contents; its object is as good as ours.
+	auto tmpFile = object.parent_path() / bfs::unique_path("%%%%%%%%%%%%.tmp");
+	{
+		bfs::ofstream ofs(tmpFile, std::ios::out | std::ios::trunc | std::ios::binary);
+		ofs.write(contents.GetData(), static_cast<std::streamsize>(contents.GetSize()));
+		if ( !ofs )
+		{
+			ofs.close();
+			bfs::remove(tmpFile, ec);
+			throw bfs::filesystem_error("Can not write", tmpFile, boost::system::errc::make_error_code(boost::system::errc::io_error));
+		}
+	}
+
+	bfs::rename(tmpFile, object, ec);
+	if ( ec )
+	{
+		boost::system::error_code removeEc;
+		bfs::remove(tmpFile, removeEc);
+		if ( !bfs::exists(object, removeEc) )
+		{
+			throw bfs::filesystem_error("Can not store", file, object, ec);
+		}
+	}
+
+	return object;
+}
+
+size_t ContentStore::Collect(const bfs::path& root, std::uintmax_t& bytes)
+{
+	bytes = 0;
+
+	auto objects = root / "objects";
+	boost::system::error_code ec;
+	if ( !bfs::is_directory(objects, ec) )
+	{
+		return 0;
+	}
+
+	//Outputs are hard links, so an object only the store links to is used by no output.
+	std::vector<bfs::path> unused;
+	std::set<bfs::path> dirs;
+	bfs::recursive_directory_iterator itor(objects, ec), end;
+	for ( ; !ec && itor != end; itor.increment(ec) )
+	{
+		if ( bfs::is_directory(itor->status()) )
+		{
+			dirs.insert(itor->path());
+			continue;
+		}
+
+		boost::system::error_code countEc;
+		if ( bfs::hard_link_count(itor->path(), countEc) == 1 && !countEc )
+		{
+			unused.push_back(itor->path());
+		}
+	}
+
+	size_t ret = 0;
+	for ( auto& curObject : unused )
+	{
+		auto size = bfs::file_size(curObject, ec);
+		if ( !ec && bfs::remove(curObject, ec) )
+		{
+			bytes += size;
+			++ret;
+		}
+	}
+
+	//Only empty fan-out directories go.
+	for ( auto& curDir : dirs )
+	{
+		bfs::remove(curDir, ec);
+	}
+
+	return ret;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+
+namespace bfs = boost::filesystem;
+
+//Content-addressed file store shared by projects and runs (Materialize Mode="Store"). A file is
+//stored once, named after the XXH64 hash and the size of its contents, and outputs are hard
+//links to the stored object, so the same vendored sources in several projects or library
+//versions take the disk space of one copy. Like HardLink outputs, store outputs must not be
+//edited in place: every output linked to the object would change with them.
+class	ContentStore
+{
+public:
+
+	explicit	ContentStore(const bfs::path& root = bfs::path()) : Root_(root) {}
+
+	bool		IsEnabled() const { return !Root_.empty(); }
+
+	//Stores the contents of file unless the store already has them and returns the object.
+	//Safe to call for the same contents from several threads and processes.
+	bfs::path	Put(const bfs::path& file) const;
+
+	//Removes every object no output links to any more and returns how many were removed;
+	//bytes receives their total size. Must not run while a conversion writes to the store.
+	static	size_t	Collect(const bfs::path& root, std::uintmax_t& bytes);
+
+	//XXH64.
+	static	std::uint64_t	Hash(const void* data, size_t size, std::uint64_t seed = 0);
+
+private:
+
+	bfs::path	Root_;
+};
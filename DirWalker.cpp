@@ -0,0 +1,297 @@
+#include "DirWalker.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <dirent.h>
+#include <sys/stat.h>
+#endif
+
+namespace
+{
+	enum class	EType
+	{
+		File,
+		Directory,
+		Other,		//Symlinks to directories (not followed, as recursive_directory_iterator does), devices, ...
+	};
+
+	class	SEntry
+	{
+	public:
+		std::string	Name_;
+		EType		Type_ = EType::Other;
+	};
+
+	bool	ListDir(const bfs::path& dir, std::vector<SEntry>& entries)
+	{
+		entries.clear();
+
+#ifdef _WIN32
+		WIN32_FIND_DATAW data;
+		auto handle = ::FindFirstFileW((dir / L"*").wstring().c_str(), &data);
+		if ( handle == INVALID_HANDLE_VALUE )
+		{
+			return false;
+		}
+
+		do
+		{
+			SEntry entry;
+			entry.Name_ = bfs::path(data.cFileName).string();
+			if ( entry.Name_ == "." || entry.Name_ == ".." )
+			{
+				continue;
+			}
+
+			if ( data.dwFileAttributes & FILE_ATTRIBUTE_REPARSE_POINT )
+			{
+				//Links and junctions: a directory target is not entered.
+				boost::system::error_code ec;
+				entry.Type_ = bfs::is_directory(dir / entry.Name_, ec) ? EType::Other : EType::File;
+			}
+			else
+			{
+				entry.Type_ = (data.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) ? EType::Directory : EType::File;
+			}
+			entries.push_back(entry);
+		} while ( ::FindNextFileW(handle, &data) );
+
+		::FindClose(handle);
+#else
+		auto dirHandle = ::opendir(dir.c_str());
+		if ( !dirHandle )
+		{
+			return false;
+		}
+
+		while ( auto ent = ::readdir(dirHandle) )
+		{
+			SEntry entry;
+			entry.Name_ = ent->d_name;
+			if ( entry.Name_ == "." || entry.Name_ == ".." )
+			{
+				continue;
+			}
+
+			switch ( ent->d_type )
+			{
+			case DT_REG:
+				entry.Type_ = EType::File;
+				break;
+			case DT_DIR:
+				entry.Type_ = EType::Directory;
+				break;
+			case DT_LNK:
+			case DT_UNKNOWN:
+				{
+					//Not every file system fills d_type; symlinks are resolved to their target.
+					struct stat st;
+					if ( ::stat((dir / entry.Name_).c_str(), &st) == 0 )
+					{
+						if ( S_ISREG(st.st_mode) )
+						{
+							entry.Type_ = EType::File;
+						}
+						else if ( S_ISDIR(st.st_mode) && ent->d_type == DT_UNKNOWN )
+						{
+							entry.Type_ = EType::Directory;
+						}
+					}
+				}
+				break;
+			default:
+				break;
+			}
+			entries.push_back(entry);
+		}
+
+		::closedir(dirHandle);
+#endif
+
+		return true;
+	}
+
+	inline	bool	SameChar(char lhs, char rhs)
+	{
+#ifdef _WIN32
+		return std::tolower(static_cast<unsigned char>(lhs)) == std::tolower(static_cast<unsigned char>(rhs));
+#else
+		return lhs == rhs;
+#endif
+	}
+}
+
+bool DirWalker::MatchGlob(const char* pattern, const char* text)
+{
+	while ( *pattern )
+	{
+		if ( *pattern == '*' )
+		{
+			auto crossDirs = pattern[1] == '*';
+			pattern += crossDirs ? 2 : 1;
+
+			//"**/" also matches no directory at all.
+			if ( crossDirs && *pattern == '/' && MatchGlob(pattern + 1, text) )
+			{
+				return true;
+			}
+
+			for ( ;; ++text )
+			{
+				if ( MatchGlob(pattern, text) )
+				{
+					return true;
+				}
+				if ( !*text || (!crossDirs && *text == '/') )
+				{
+					return false;
+				}
+			}
+		}
+
+		if ( !*text || (*pattern == '?' ? *text == '/' : !SameChar(*pattern, *text)) )
+		{
+			return false;
+		}
+
+		++pattern;
+		++text;
+	}
+
+	return !*text;
+}
+
+void DirWalker::SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude)
+{
+	Include_ = include;
+	Exclude_ = exclude;
+}
+
+bool DirWalker::IsExcluded(const std::string& relPath, const std::string& name) const
+{
+	for ( auto& curPattern : Exclude_ )
+	{
+		auto& text = curPattern.find('/') == std::string::npos ? name : relPath;
+		if ( MatchGlob(curPattern.c_str(), text.c_str()) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+bool DirWalker::IsIncluded(const std::string& relPath, const std::string& name) const
+{
+	if ( Include_.empty() )
+	{
+		return true;
+	}
+
+	for ( auto& curPattern : Include_ )
+	{
+		auto& text = curPattern.find('/') == std::string::npos ? name : relPath;
+		if ( MatchGlob(curPattern.c_str(), text.c_str()) )
+		{
+			return true;
+		}
+	}
+
+	return false;
+}
+
+std::vector<DirWalker::SFile> DirWalker::Walk(const bfs::path& root, unsigned jobCount) const
+{
+	if ( jobCount == 0 )
+	{
+		jobCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::deque<std::string> dirs(1);	//Below root; "" is root itself.
+	size_t busy = 0;
+	std::vector<SFile> ret;
+
+	auto worker = [&]()
+	{
+		std::vector<SFile> found;
+		std::vector<SEntry> entries;
+		std::vector<std::string> subDirs;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		for ( ;; )
+		{
+			//Done once nothing is queued and no one can queue more.
+			wakeUp.wait(lock, [&]() { return !dirs.empty() || busy == 0; });
+			if ( dirs.empty() )
+			{
+				break;
+			}
+
+			auto relDir = std::move(dirs.front());
+			dirs.pop_front();
+			++busy;
+			lock.unlock();
+
+			auto dir = relDir.empty() ? root : root / relDir;
+			if ( !ListDir(dir, entries) )
+			{
+				std::cerr << "Can not list " << dir << std::endl;
+			}
+
+			subDirs.clear();
+			for ( auto& curEntry : entries )
+			{
+				auto relPath = relDir.empty() ? curEntry.Name_ : relDir + '/' + curEntry.Name_;
+				if ( curEntry.Type_ == EType::Other || IsExcluded(relPath, curEntry.Name_) )
+				{
+					continue;
+				}
+
+				if ( curEntry.Type_ == EType::Directory )
+				{
+					subDirs.push_back(relPath);
+				}
+				else if ( IsIncluded(relPath, curEntry.Name_) )
+				{
+					SFile file;
+					file.Path_ = dir / curEntry.Name_;
+					file.RelPath_ = relPath;
+					found.push_back(file);
+				}
+			}
+
+			lock.lock();
+			dirs.insert(dirs.end(), subDirs.begin(), subDirs.end());
+			--busy;
+			wakeUp.notify_all();
+		}
+
+		ret.insert(ret.end(), found.begin(), found.end());
+	};
+
+	std::vector<std::thread> threads;
+	for ( unsigned index = 1; index < jobCount; ++index )
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for ( auto& curThread : threads )
+	{
+		curThread.join();
+	}
+
+	std::sort(ret.begin(), ret.end(), [](const SFile& lhs, const SFile& rhs) { return lhs.RelPath_ < rhs.RelPath_; });
+	return ret;
+}
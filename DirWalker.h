@@ -0,0 +1,42 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//Lists every file below a directory on several threads. Directories go to a shared queue and
+//each thread lists one at a time, queueing the subdirectories it finds, so the work is split
+//by subdirectory. Entry types come from the listing itself (d_type, FindFirstFile attributes);
+//a file is only stat'ed when the file system does not report its type or it is a symlink.
+class	DirWalker
+{
+public:
+
+	class	SFile
+	{
+	public:
+		bfs::path	Path_;
+		std::string	RelPath_;	//Below the root, '/' separated.
+	};
+
+	//Glob patterns: '*' and '?' stop at '/', "**" does not. A pattern without '/' is matched
+	//against the file or directory name, one with '/' against the path below the root. With
+	//include patterns only matching files are listed; excluded directories are not entered.
+	void		SetFilter(const std::vector<std::string>& include, const std::vector<std::string>& exclude);
+
+	//Files sorted by RelPath_. jobCount == 0 means one job per hardware thread.
+	std::vector<SFile>	Walk(const bfs::path& root, unsigned jobCount = 0) const;
+
+	static	bool	MatchGlob(const char* pattern, const char* text);
+
+private:
+
+	bool		IsExcluded(const std::string& relPath, const std::string& name) const;
+	bool		IsIncluded(const std::string& relPath, const std::string& name) const;
+
+	std::vector<std::string>	Include_;
+	std::vector<std::string>	Exclude_;
+};
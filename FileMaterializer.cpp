@@ -0,0 +1,716 @@
+#include "FileMaterializer.h"
+#include "FileTime.h"
+#include "PathTable.h"
+#include "TarWriter.h"
+#include "UringCopier.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstdlib>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <sstream>
+#include <thread>
+
+#ifdef __linux__
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace
+{
+	//Files handed to io_uring at a time by one worker.
+	const size_t	sUringBatchSize = 256;
+
+	//A whole manifest field as a decimal number. False for anything else, e.g. a line cut short
+	//by an interrupted run.
+	bool	ParseNumber(const std::string& text, long long& value)
+	{
+		if ( text.empty() )
+		{
+			return false;
+		}
+
+		errno = 0;
+		char* end = nullptr;
+		value = std::strtoll(text.c_str(), &end, 10);
+		return errno == 0 && end == text.c_str() + text.size();
+	}
+
+#ifdef __linux__
+	class	SFileDesc
+	{
+	public:
+		explicit	SFileDesc(int fd) : Fd_(fd) {}
+		~SFileDesc() { if ( Fd_ >= 0 ) ::close(Fd_); }
+
+		int		Fd_;
+	};
+
+	bool	CloneFile(const bfs::path& from, const bfs::path& to, bool reflink)
+	{
+		SFileDesc src(::open(from.c_str(), O_RDONLY | O_CLOEXEC));
+		if ( src.Fd_ < 0 )
+		{
+			return false;
+		}
+
+		struct stat st;
+		if ( ::fstat(src.Fd_, &st) != 0 )
+		{
+			return false;
+		}
+
+		SFileDesc dst(::open(to.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 0777));
+		if ( dst.Fd_ < 0 )
+		{
+			return false;
+		}
+
+		if ( reflink )
+		{
+#ifdef FICLONE
+			return ::ioctl(dst.Fd_, FICLONE, src.Fd_) == 0;
+#else
+			return false;
+#endif
+		}
+
+		off_t remaining = st.st_size;
+		while ( remaining > 0 )
+		{
+			auto written = ::copy_file_range(src.Fd_, nullptr, dst.Fd_, nullptr, static_cast<size_t>(remaining), 0);
+			if ( written <= 0 )
+			{
+				return false;
+			}
+			remaining -= written;
+		}
+
+		return true;
+	}
+#endif
+}
+
+SharedCopyCache::EClaim SharedCopyCache::Claim(const FileMaterializer::SCopyItem& item, bfs::path& cloneFrom, bfs::path& otherFrom)
+{
+	auto& paths = PathTable::GetInstance();
+	auto to = paths.Intern(item.To_);
+	auto from = paths.Intern(item.From_);
+
+	std::lock_guard<std::mutex> lock(Mutex_);
+
+	SDest dest;
+	dest.From_ = from;
+	dest.State_ = EState::Pending;
+
+	auto result = Dests_.emplace(to, dest);
+	if ( !result.second )
+	{
+		if ( result.first->second.From_ == from )
+		{
+			return EClaim::Shared;
+		}
+
+		otherFrom = paths.ToPath(result.first->second.From_);
+		return EClaim::Conflict;
+	}
+
+	auto itor = Sources_.find(from);
+	if ( itor != Sources_.end() )
+	{
+		cloneFrom = paths.ToPath(itor->second);
+	}
+
+	return EClaim::Materialize;
+}
+
+bool SharedCopyCache::Wait(const FileMaterializer::SCopyItem& item)
+{
+	auto to = PathTable::GetInstance().Intern(item.To_);
+
+	std::unique_lock<std::mutex> lock(Mutex_);
+	auto& dest = Dests_.at(to);
+	Changed_.wait(lock, [&]() { return dest.State_ != EState::Pending; });
+	return dest.State_ == EState::Done;
+}
+
+void SharedCopyCache::Done(const FileMaterializer::SCopyItem& item)
+{
+	SetState(item, EState::Done);
+}
+
+void SharedCopyCache::Fail(const FileMaterializer::SCopyItem& item)
+{
+	SetState(item, EState::Failed);
+}
+
+void SharedCopyCache::SetState(const FileMaterializer::SCopyItem& item, EState state)
+{
+	auto& paths = PathTable::GetInstance();
+	auto from = paths.Intern(item.From_);
+	auto to = paths.Intern(item.To_);
+
+	{
+		std::lock_guard<std::mutex> lock(Mutex_);
+
+		auto& dest = Dests_.at(to);
+		if ( dest.State_ != EState::Pending )
+		{
+			return;
+		}
+
+		dest.State_ = state;
+		if ( state == EState::Done )
+		{
+			Sources_.emplace(from, to);
+		}
+	}
+
+	Changed_.notify_all();
+}
+
+FileMaterializer::FileMaterializer(unsigned jobCount) : JobCount_(jobCount)
+{
+	if ( JobCount_ == 0 )
+	{
+		JobCount_ = std::max(1u, std::thread::hardware_concurrency());
+	}
+}
+
+void FileMaterializer::Add(const bfs::path& from, const bfs::path& to, EMode mode)
+{
+	SCopyItem item;
+	item.From_ = from;
+	item.To_ = to;
+	item.Mode_ = mode;
+
+	CopyList_.push_back(item);
+}
+
+namespace
+{
+	const std::pair<const char*, FileMaterializer::EMode> sModes[] =
+	{
+		{ "Copy", FileMaterializer::EMode::Copy },
+		{ "HardLink", FileMaterializer::EMode::HardLink },
+		{ "SymLink", FileMaterializer::EMode::SymLink },
+		{ "RefLink", FileMaterializer::EMode::RefLink },
+		{ "CopyFileRange", FileMaterializer::EMode::CopyFileRange },
+		{ "Store", FileMaterializer::EMode::Store },
+	};
+}
+
+bool FileMaterializer::ParseMode(const std::string& name, EMode& mode)
+{
+	for ( auto& curMode : sModes )
+	{
+		if ( name == curMode.first )
+		{
+			mode = curMode.second;
+			return true;
+		}
+	}
+
+	return false;
+}
+
+const char* FileMaterializer::GetModeName(EMode mode)
+{
+	for ( auto& curMode : sModes )
+	{
+		if ( mode == curMode.second )
+		{
+			return curMode.first;
+		}
+	}
+
+	return "";
+}
+
+bool FileMaterializer::MaterializeFile(const SCopyItem& item) const
+{
+	//The old destination is always unlinked first: writing through a hard link or symlink
+	//left by an earlier run would overwrite the source file itself.
+	boost::system::error_code ec;
+	bfs::remove(item.To_, ec);
+
+	switch ( item.Mode_ )
+	{
+	case EMode::HardLink:
+		bfs::create_hard_link(item.From_, item.To_, ec);
+		if ( !ec )
+		{
+			return true;
+		}
+		break;
+	case EMode::SymLink:
+		bfs::create_symlink(item.From_, item.To_, ec);
+		if ( !ec )
+		{
+			return true;
+		}
+		break;
+#ifdef __linux__
+	case EMode::RefLink:
+	case EMode::CopyFileRange:
+		if ( CloneFile(item.From_, item.To_, item.Mode_ == EMode::RefLink) )
+		{
+			return true;
+		}
+		bfs::remove(item.To_, ec);
+		break;
+#endif
+	case EMode::Store:
+		if ( Store_.IsEnabled() )
+		{
+			auto object = Store_.Put(item.From_);
+			bfs::create_hard_link(object, item.To_, ec);
+			if ( !ec )
+			{
+				return true;
+			}
+
+			//The store is on another volume: the output is a copy the store does not count.
+			bfs::copy_file(object, item.To_, bfs::copy_option::overwrite_if_exists);
+			return false;
+		}
+		break;
+	default:
+		break;
+	}
+
+	bfs::copy_file(item.From_, item.To_, bfs::copy_option::overwrite_if_exists);
+	return item.Mode_ == EMode::Copy;
+}
+
+void FileMaterializer::SetManifest(const bfs::path& manifestPath)
+{
+	ManifestPath_ = manifestPath;
+}
+
+void FileMaterializer::Plan()
+{
+	Plan_.clear();
+	Conflicts_.clear();
+	DuplicateCount_ = 0;
+
+	//A destination is copied once; concurrent copies to the same file would race.
+	std::map<bfs::path, size_t> dests;
+	for ( auto& curItem : CopyList_ )
+	{
+		auto result = dests.emplace(curItem.To_, Plan_.size());
+		if ( result.second )
+		{
+			Plan_.push_back(curItem);
+			continue;
+		}
+
+		auto& kept = Plan_[result.first->second];
+		if ( kept.From_ != curItem.From_ )
+		{
+			SConflict conflict;
+			conflict.To_ = curItem.To_;
+			conflict.KeptFrom_ = kept.From_;
+			conflict.DroppedFrom_ = curItem.From_;
+			Conflicts_.push_back(conflict);
+		}
+		else
+		{
+			++DuplicateCount_;
+		}
+	}
+}
+
+void FileMaterializer::Run()
+{
+	CopiedCount_ = 0;
+	SkippedCount_ = 0;
+	FallbackCount_ = 0;
+	SharedCount_ = 0;
+	Foreign_.clear();
+
+	Plan();
+
+	std::vector<const SCopyItem*> workList;
+	for ( auto& curItem : Plan_ )
+	{
+		workList.push_back(&curItem);
+	}
+
+	//An archive has no directories to create.
+	if ( !Archive_ )
+	{
+		std::set<bfs::path> dirs;
+		for ( auto& curItem : Plan_ )
+		{
+			dirs.insert(curItem.To_.parent_path());
+		}
+
+		//Directories are created once up front so the workers only copy.
+		PhaseTimer timer(Report_, ProjectReport::EPhase::CreateDirectories);
+		for ( auto& curDir : dirs )
+		{
+			bfs::create_directories(curDir);
+		}
+
+		if ( Report_ )
+		{
+			Report_->Add(ProjectReport::ECounter::CreateDirectories, dirs.size());
+		}
+	}
+
+	auto incremental = !ManifestPath_.empty() && !Archive_;
+
+	std::map<std::string, SManifestEntry> oldManifest;
+	if ( incremental && bfs::exists(ManifestPath_) )
+	{
+		bfs::ifstream ifs(ManifestPath_);
+		std::string line;
+		while ( std::getline(ifs, line) )
+		{
+			//to \t from \t mode \t size \t writeTime, the time in nanoseconds
+			std::vector<std::string> fields;
+			std::istringstream iss(line);
+			std::string field;
+			while ( std::getline(iss, field, '\t') )
+			{
+				fields.push_back(field);
+			}
+
+			//A line that does not parse is left out: its file is materialized again. So are the
+			//lines of manifests written before the mode was recorded.
+			SManifestEntry entry;
+			long long size = 0, writeTime = 0;
+			if ( fields.size() != 5 || !ParseMode(fields[2], entry.Mode_) || !ParseNumber(fields[3], size) || !ParseNumber(fields[4], writeTime) || size < 0 )
+			{
+				continue;
+			}
+
+			entry.From_ = fields[1];
+			entry.Size_ = static_cast<std::uintmax_t>(size);
+			entry.WriteTime_ = writeTime;
+			oldManifest[fields[0]] = entry;
+		}
+	}
+
+	std::vector<SManifestEntry> newManifest(workList.size());
+
+	std::atomic<size_t> next(0), copied(0), skipped(0), fallback(0), shared(0);
+	std::atomic<bool> failed(false);
+	std::exception_ptr firstError;
+	std::mutex errorMutex;
+
+	auto recordError = [&]()
+	{
+		std::lock_guard<std::mutex> lock(errorMutex);
+		if ( !firstError )
+		{
+			firstError = std::current_exception();
+		}
+		failed = true;
+	};
+
+	auto worker = [&]()
+	{
+		//Plain copies are batched through io_uring when asked for and available. A file the
+		//ring could not copy goes through MaterializeFile like any other.
+		std::unique_ptr<UringCopier> copier;
+		if ( UseIoUring_ )
+		{
+			copier.reset(new UringCopier);
+			if ( !copier->IsAvailable() )
+			{
+				copier.reset();
+			}
+		}
+
+		std::vector<UringCopier::SFile> batch;
+		std::vector<const SCopyItem*> batchItems;
+
+		auto flush = [&]()
+		{
+			if ( batch.empty() )
+			{
+				return;
+			}
+
+			copier->Copy(batch);
+			for ( size_t index = 0; index < batch.size(); ++index )
+			{
+				//Claims left unwritten are released, so other projects do not wait on them.
+				if ( failed )
+				{
+					if ( SharedCache_ )
+					{
+						SharedCache_->Fail(*batchItems[index]);
+					}
+					continue;
+				}
+
+				try
+				{
+					if ( !batch[index].Copied_ )
+					{
+						MaterializeFile(*batchItems[index]);
+					}
+					++copied;
+
+					if ( SharedCache_ )
+					{
+						SharedCache_->Done(*batchItems[index]);
+					}
+
+					if ( Report_ )
+					{
+						Report_->Add(ProjectReport::ECounter::BytesWritten, bfs::file_size(batch[index].To_));
+					}
+				}
+				catch ( ... )
+				{
+					if ( SharedCache_ )
+					{
+						SharedCache_->Fail(*batchItems[index]);
+					}
+					recordError();
+				}
+			}
+
+			batch.clear();
+			batchItems.clear();
+		};
+
+		while ( !failed )
+		{
+			auto index = next++;
+			if ( index >= workList.size() )
+			{
+				break;
+			}
+
+			//A claim this iteration still has to finish or fail.
+			const SCopyItem* claimed = nullptr;
+
+			try
+			{
+				auto& curItem = *workList[index];
+
+				//Claimed before the incremental check: a destination this project finds up to date
+				//may still be claimed by another project for a different source.
+				bfs::path cloneFrom;
+				if ( SharedCache_ )
+				{
+					bfs::path otherFrom;
+					auto claim = SharedCache_->Claim(curItem, cloneFrom, otherFrom);
+					if ( claim == SharedCopyCache::EClaim::Shared )
+					{
+						//Claims held in our batch are written first: the claimant may be waiting on them.
+						flush();
+						if ( !SharedCache_->Wait(curItem) )
+						{
+							throw bfs::filesystem_error("The project that claimed this file failed to write it", curItem.To_, boost::system::errc::make_error_code(boost::system::errc::io_error));
+						}
+
+						++shared;
+
+						std::lock_guard<std::mutex> lock(errorMutex);
+						Foreign_.push_back(curItem.To_);
+						continue;
+					}
+
+					if ( claim == SharedCopyCache::EClaim::Conflict )
+					{
+						SConflict conflict;
+						conflict.To_ = curItem.To_;
+						conflict.KeptFrom_ = otherFrom;
+						conflict.DroppedFrom_ = curItem.From_;
+
+						std::lock_guard<std::mutex> lock(errorMutex);
+						Conflicts_.push_back(conflict);
+						Foreign_.push_back(curItem.To_);
+						continue;
+					}
+
+					claimed = &curItem;
+				}
+
+				//Entries are filled only for destinations this project writes; the others stay empty
+				//and are left out of the manifest.
+				if ( incremental )
+				{
+					auto& entry = newManifest[index];
+					entry.From_ = curItem.From_.string();
+					entry.Mode_ = curItem.Mode_;
+					entry.Size_ = bfs::file_size(curItem.From_);
+					entry.WriteTime_ = GetWriteTimeNs(curItem.From_);
+
+					//A destination made in another mode is replaced: a link left behind would let
+					//an edit of the output write through to the source.
+					auto itor = oldManifest.find(curItem.To_.string());
+					if ( itor != oldManifest.end() && itor->second.From_ == entry.From_ && itor->second.Mode_ == entry.Mode_ &&
+						itor->second.Size_ == entry.Size_ && itor->second.WriteTime_ == entry.WriteTime_ )
+					{
+						boost::system::error_code ec;
+						if ( bfs::file_size(curItem.To_, ec) == entry.Size_ && !ec )
+						{
+							++skipped;
+							if ( SharedCache_ )
+							{
+								SharedCache_->Done(curItem);
+							}
+							continue;
+						}
+					}
+				}
+
+#ifdef __linux__
+				//The same source was already copied by another project: clone that copy instead of
+				//reading the source again.
+				auto cloneable = !Archive_ && curItem.Mode_ != EMode::HardLink && curItem.Mode_ != EMode::SymLink && curItem.Mode_ != EMode::Store;
+				if ( cloneable && !cloneFrom.empty() )
+				{
+					boost::system::error_code ec;
+					bfs::remove(curItem.To_, ec);
+					if ( CloneFile(cloneFrom, curItem.To_, true) )
+					{
+						++copied;
+						SharedCache_->Done(curItem);
+						continue;
+					}
+				}
+#endif
+
+				//Every mode stores the file contents in an archive.
+				if ( Archive_ )
+				{
+					auto size = Archive_->AddFile(curItem.To_, curItem.From_);
+					++copied;
+
+					if ( SharedCache_ )
+					{
+						SharedCache_->Done(curItem);
+					}
+
+					if ( Report_ )
+					{
+						Report_->Add(ProjectReport::ECounter::BytesWritten, size);
+					}
+					continue;
+				}
+
+				if ( copier && curItem.Mode_ == EMode::Copy )
+				{
+					UringCopier::SFile file;
+					file.From_ = curItem.From_;
+					file.To_ = curItem.To_;
+					batch.push_back(file);
+					batchItems.push_back(&curItem);
+					claimed = nullptr;
+
+					if ( batch.size() >= sUringBatchSize )
+					{
+						flush();
+					}
+					continue;
+				}
+
+				auto linked = curItem.Mode_ == EMode::HardLink || curItem.Mode_ == EMode::SymLink || curItem.Mode_ == EMode::Store;
+				if ( !MaterializeFile(curItem) )
+				{
+					++fallback;
+					linked = false;
+				}
+				++copied;
+
+				if ( SharedCache_ )
+				{
+					SharedCache_->Done(curItem);
+				}
+
+				if ( Report_ && !linked )
+				{
+					Report_->Add(ProjectReport::ECounter::BytesWritten, bfs::file_size(curItem.To_));
+				}
+			}
+			catch ( ... )
+			{
+				if ( claimed )
+				{
+					SharedCache_->Fail(*claimed);
+				}
+				recordError();
+			}
+		}
+
+		flush();
+	};
+
+	auto threadCount = std::min<size_t>(JobCount_, workList.size());
+
+	{
+		PhaseTimer timer(Report_, ProjectReport::EPhase::Copy);
+
+		std::vector<std::thread> threads;
+		for ( size_t index = 1; index < threadCount; ++index )
+		{
+			threads.emplace_back(worker);
+		}
+		worker();
+
+		for ( auto& curThread : threads )
+		{
+			curThread.join();
+		}
+	}
+
+	CopiedCount_ = copied;
+	SkippedCount_ = skipped;
+	FallbackCount_ = fallback;
+	SharedCount_ = shared;
+
+	if ( firstError )
+	{
+		std::rethrow_exception(firstError);
+	}
+
+	if ( incremental )
+	{
+		std::map<std::string, const SManifestEntry*> sorted;
+		for ( size_t index = 0; index < workList.size(); ++index )
+		{
+			if ( !newManifest[index].From_.empty() )
+			{
+				sorted[workList[index]->To_.string()] = &newManifest[index];
+			}
+		}
+
+		//Written beside the old one and renamed over it, so an interrupted run leaves either
+		//manifest whole.
+		bfs::create_directories(ManifestPath_.parent_path());
+		auto tmpPath = ManifestPath_;
+		tmpPath += ".tmp";
+		{
+			bfs::ofstream ofs(tmpPath, std::ios::trunc | std::ios::out);
+			for ( auto& curEntry : sorted )
+			{
+				ofs << curEntry.first << '\t' << curEntry.second->From_ << '\t' << GetModeName(curEntry.second->Mode_) << '\t' << curEntry.second->Size_ << '\t' << static_cast<long long>(curEntry.second->WriteTime_) << '\n';
+			}
+
+			if ( !ofs.flush() )
+			{
+				throw bfs::filesystem_error("Can not write the manifest", tmpPath, boost::system::errc::make_error_code(boost::system::errc::io_error));
+			}
+		}
+		bfs::rename(tmpPath, ManifestPath_);
+	}
+}
@@ -0,0 +1,190 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include "ContentStore.h"
+#include "PathTable.h"
+#include "RunReport.h"
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+class	SharedCopyCache;
+class	TarWriter;
+
+//Collects every (source, destination) copy of a project first and performs them afterwards
+//on a bounded pool of worker threads.
+class	FileMaterializer
+{
+public:
+
+	//How a destination file is produced. Every mode other than Copy falls back to a plain copy
+	//when the file system or platform can not do it.
+	enum class	EMode
+	{
+		Copy,
+		HardLink,
+		SymLink,
+		RefLink,		//FICLONE, Linux only
+		CopyFileRange,	//copy_file_range, Linux only
+		Store,			//hard link to the content-addressed store, see SetStore
+	};
+
+	class	SCopyItem
+	{
+	public:
+		bfs::path	From_;
+		bfs::path	To_;
+		EMode		Mode_ = EMode::Copy;
+	};
+
+	typedef	std::vector<SCopyItem>	CopyList;
+
+	//A destination two different sources were planned for. The first source is kept.
+	class	SConflict
+	{
+	public:
+		bfs::path	To_;
+		bfs::path	KeptFrom_;
+		bfs::path	DroppedFrom_;
+	};
+
+	//jobCount == 0 means one job per hardware thread.
+	explicit	FileMaterializer(unsigned jobCount = 0);
+
+	void		Add(const bfs::path& from, const bfs::path& to, EMode mode = EMode::Copy);
+
+	//Parses the Mode attribute used in config.xml ("Copy", "HardLink", ...).
+	static	bool	ParseMode(const std::string& name, EMode& mode);
+	static	const char*	GetModeName(EMode mode);
+
+	//Enables incremental mode: a copy is skipped when the manifest records the same source,
+	//mode, size and modification time for its destination and the destination is still there.
+	void		SetManifest(const bfs::path& manifestPath);
+
+	//Directory creation and copy times, directory count and bytes written go to report when it
+	//is not null.
+	void		SetReport(ProjectReport* report) { Report_ = report; }
+
+	//Copies of EMode::Copy go through io_uring on Linux when the kernel allows it.
+	void		SetUseIoUring(bool useIoUring) { UseIoUring_ = useIoUring; }
+
+	//Content-addressed store used by EMode::Store. Without one those items are copied.
+	void		SetStore(const bfs::path& storeRoot) { Store_ = ContentStore(storeRoot); }
+
+	//Shares what was materialized with the other projects of the run.
+	void		SetSharedCache(SharedCopyCache* cache) { SharedCache_ = cache; }
+
+	//Writes the files into archive instead of the file system. No directories are created and
+	//the manifest is neither read nor written.
+	void		SetArchive(TarWriter* archive) { Archive_ = archive; }
+
+	//Builds the plan from everything added so far: repeated (source, destination) pairs are
+	//removed and destinations claimed by two sources are recorded as conflicts. Does not touch
+	//the disk, so it is all a dry run needs.
+	void		Plan();
+
+	//Plans, creates the destination directories, copies every planned file and returns once all
+	//workers have stopped. The first copy error is rethrown to the caller.
+	void		Run();
+
+	const CopyList&	GetCopyList() const { return CopyList_; }
+	const CopyList&	GetPlan() const { return Plan_; }
+	const std::vector<SConflict>&	GetConflicts() const { return Conflicts_; }
+
+	//Planned destinations Run left to another project of the run: it writes the same file, or a
+	//different source there.
+	const std::vector<bfs::path>&	GetForeignList() const { return Foreign_; }
+	size_t		GetDuplicateCount() const { return DuplicateCount_; }
+	size_t		GetCopiedCount() const { return CopiedCount_; }
+	size_t		GetSkippedCount() const { return SkippedCount_; }
+	size_t		GetFallbackCount() const { return FallbackCount_; }
+	size_t		GetSharedCount() const { return SharedCount_; }
+
+private:
+
+	class	SManifestEntry
+	{
+	public:
+		std::string		From_;
+		EMode			Mode_ = EMode::Copy;
+		std::uintmax_t	Size_ = 0;
+		std::int64_t	WriteTime_ = 0;	//Nanoseconds, see GetWriteTimeNs.
+	};
+
+	//Returns false when the mode fell back to a plain copy.
+	bool		MaterializeFile(const SCopyItem& item) const;
+
+	unsigned	JobCount_;
+	CopyList	CopyList_;
+	CopyList	Plan_;
+	std::vector<SConflict>	Conflicts_;
+	std::vector<bfs::path>	Foreign_;
+	size_t		DuplicateCount_ = 0;
+	bfs::path	ManifestPath_;
+	ProjectReport*	Report_ = nullptr;
+	bool		UseIoUring_ = false;
+	ContentStore	Store_;
+	SharedCopyCache*	SharedCache_ = nullptr;
+	TarWriter*	Archive_ = nullptr;
+	size_t		CopiedCount_ = 0;
+	size_t		SkippedCount_ = 0;
+	size_t		FallbackCount_ = 0;
+	size_t		SharedCount_ = 0;
+};
+
+//Files materialized by every project of one run. A destination listed by several projects is
+//written by the first one to claim it; a source already copied elsewhere is cloned from that
+//copy where the file system supports it, so it is not read and written again.
+class	SharedCopyCache
+{
+public:
+
+	enum class	EClaim
+	{
+		Materialize,	//Ours to write. cloneFrom is a finished copy of the same source, if any.
+		Shared,			//Another project writes the same file; Wait for it before relying on it.
+		Conflict,		//Another project writes a different source there; otherFrom names it.
+	};
+
+	//Every Materialize claim must end in Done or Fail, or its waiters never return.
+	EClaim		Claim(const FileMaterializer::SCopyItem& item, bfs::path& cloneFrom, bfs::path& otherFrom);
+
+	//Blocks until the project that claimed item's destination finished it. False when it failed.
+	bool		Wait(const FileMaterializer::SCopyItem& item);
+
+	//A claimed destination was written and may be cloned from.
+	void		Done(const FileMaterializer::SCopyItem& item);
+
+	//A claimed destination was not written. Does nothing once it is done.
+	void		Fail(const FileMaterializer::SCopyItem& item);
+
+private:
+
+	enum class	EState
+	{
+		Pending,
+		Done,
+		Failed,
+	};
+
+	class	SDest
+	{
+	public:
+		PathTable::ID	From_;
+		EState			State_;
+	};
+
+	void		SetState(const FileMaterializer::SCopyItem& item, EState state);
+
+	std::mutex	Mutex_;
+	std::condition_variable	Changed_;
+	std::unordered_map<PathTable::ID, SDest>	Dests_;	//destination -> source and its state
+	std::unordered_map<PathTable::ID, PathTable::ID>	Sources_;	//source -> finished destination
+};
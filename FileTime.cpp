@@ -0,0 +1,53 @@
+#include "FileTime.h"
+
+#include <boost/filesystem/operations.hpp>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <cerrno>
+#include <sys/stat.h>
+#endif
+
+std::int64_t GetWriteTimeNs(const bfs::path& file, boost::system::error_code& ec)
+{
+	ec.clear();
+
+#ifdef _WIN32
+	WIN32_FILE_ATTRIBUTE_DATA data;
+	if ( !::GetFileAttributesExW(file.wstring().c_str(), GetFileExInfoStandard, &data) )
+	{
+		ec.assign(static_cast<int>(::GetLastError()), boost::system::system_category());
+		return 0;
+	}
+
+	//100 ns intervals since 1601.
+	auto ticks = (static_cast<std::int64_t>(data.ftLastWriteTime.dwHighDateTime) << 32) | data.ftLastWriteTime.dwLowDateTime;
+	return (ticks - 116444736000000000LL) * 100;
+#else
+	struct stat st;
+	if ( ::stat(file.c_str(), &st) != 0 )
+	{
+		ec.assign(errno, boost::system::system_category());
+		return 0;
+	}
+
+#ifdef __APPLE__
+	auto& time = st.st_mtimespec;
+#else
+	auto& time = st.st_mtim;
+#endif
+	return static_cast<std::int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+#endif
+}
+
+std::int64_t GetWriteTimeNs(const bfs::path& file)
+{
+	boost::system::error_code ec;
+	auto ret = GetWriteTimeNs(file, ec);
+	if ( ec )
+	{
+		throw bfs::filesystem_error("Can not get the write time", file, ec);
+	}
+	return ret;
+}
@@ -0,0 +1,15 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+#include <boost/system/error_code.hpp>
+
+#include <cstdint>
+
+namespace bfs = boost::filesystem;
+
+//Last write time of file in nanoseconds since the epoch, as precise as the file system keeps it
+//(st_mtim, FILETIME). bfs::last_write_time has whole seconds only, so a file written again
+//within the second it was recorded in would look unchanged.
+//Sets ec when the file can not be queried; the other form throws bfs::filesystem_error.
+std::int64_t	GetWriteTimeNs(const bfs::path& file, boost::system::error_code& ec);
+std::int64_t	GetWriteTimeNs(const bfs::path& file);
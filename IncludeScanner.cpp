@@ -0,0 +1,278 @@
+#include "IncludeScanner.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cctype>
+#include <condition_variable>
+#include <deque>
+#include <mutex>
+#include <thread>
+
+namespace
+{
+	inline	bool	IsBlank(char value)
+	{
+		return value == ' ' || value == '\t';
+	}
+}
+
+void IncludeScanner::AddFile(PathTable::ID to, const bfs::path& from)
+{
+	Files_.emplace(to, from);
+}
+
+void IncludeScanner::AddIncludeDir(PathTable::ID dir)
+{
+	if ( std::find(IncludeDirs_.begin(), IncludeDirs_.end(), dir) == IncludeDirs_.end() )
+	{
+		IncludeDirs_.push_back(dir);
+	}
+}
+
+void IncludeScanner::AddRoot(PathTable::ID to)
+{
+	Roots_.push_back(to);
+}
+
+bool IncludeScanner::IsHeader(const bfs::path& file)
+{
+	static	const char*	sExtensions[] = { ".h", ".hh", ".hpp", ".hxx", ".h++", ".inl", ".ipp", ".tcc", ".inc" };
+
+	auto extension = file.extension().string();
+	std::transform(extension.begin(), extension.end(), extension.begin(), [](char value) { return static_cast<char>(std::tolower(static_cast<unsigned char>(value))); });
+
+	for ( auto curExtension : sExtensions )
+	{
+		if ( extension == curExtension )
+		{
+			return true;
+		}
+	}
+	return false;
+}
+
+void IncludeScanner::ParseIncludes(const char* data, size_t size, std::vector<SInclude>& includes, size_t* firstDefine)
+{
+	includes.clear();
+	if ( firstDefine )
+	{
+		*firstDefine = 0;
+	}
+
+	auto end = data + size;
+	size_t lineNumber = 0;
+	for ( auto line = data; line < end; )
+	{
+		++lineNumber;
+		auto lineEnd = std::find(line, end, '\n');
+
+		//[blanks] # [blanks] include [blanks] "name" or <name>. Directives in block comments
+		//are taken too; following one include too many is harmless.
+		auto ptr = line;
+		while ( ptr < lineEnd && IsBlank(*ptr) )
+		{
+			++ptr;
+		}
+
+		if ( ptr < lineEnd && *ptr == '#' )
+		{
+			++ptr;
+			while ( ptr < lineEnd && IsBlank(*ptr) )
+			{
+				++ptr;
+			}
+
+			if ( firstDefine && *firstDefine == 0 && ((lineEnd - ptr >= 6 && std::equal(ptr, ptr + 6, "define")) || (lineEnd - ptr >= 5 && std::equal(ptr, ptr + 5, "undef"))) )
+			{
+				*firstDefine = lineNumber;
+			}
+
+			if ( lineEnd - ptr > 7 && std::equal(ptr, ptr + 7, "include") )
+			{
+				ptr += 7;
+				while ( ptr < lineEnd && IsBlank(*ptr) )
+				{
+					++ptr;
+				}
+
+				if ( ptr < lineEnd && (*ptr == '"' || *ptr == '<') )
+				{
+					auto close = std::find(ptr + 1, lineEnd, *ptr == '"' ? '"' : '>');
+					if ( close < lineEnd && close > ptr + 1 )
+					{
+						SInclude include;
+						include.Name_.assign(ptr + 1, close);
+						include.Quoted_ = *ptr == '"';
+						include.Line_ = lineNumber;
+						includes.push_back(include);
+					}
+				}
+			}
+		}
+
+		line = lineEnd + 1;
+	}
+}
+
+std::unordered_set<PathTable::ID> IncludeScanner::Scan(unsigned jobCount) const
+{
+	if ( jobCount == 0 )
+	{
+		jobCount = std::max(1u, std::thread::hardware_concurrency());
+	}
+
+	auto& paths = PathTable::GetInstance();
+
+	//Files by name, for quoted includes that resolve nowhere.
+	std::unordered_map<std::string, std::vector<PathTable::ID>> byName;
+	for ( auto& curFile : Files_ )
+	{
+		byName[paths.GetName(curFile.first)].push_back(curFile.first);
+	}
+
+	std::mutex mutex;
+	std::condition_variable wakeUp;
+	std::unordered_set<PathTable::ID> ret;
+	std::deque<PathTable::ID> queue;
+	size_t busy = 0;
+
+	//The directories of the files above each file on its include stacks, sorted. A file
+	//reached through a new includer directory is read again.
+	std::unordered_map<PathTable::ID, std::vector<PathTable::ID>> includers;
+
+	for ( auto curRoot : Roots_ )
+	{
+		if ( Files_.count(curRoot) > 0 && ret.insert(curRoot).second )
+		{
+			includers[curRoot];
+			queue.push_back(curRoot);
+		}
+	}
+
+	//Same shape as DirWalker: each thread reads one file at a time and queues what it reaches.
+	auto worker = [&]()
+	{
+		std::vector<SInclude> includes;
+		std::vector<PathTable::ID> found;
+		std::vector<PathTable::ID> stack;
+
+		std::unique_lock<std::mutex> lock(mutex);
+		for ( ;; )
+		{
+			wakeUp.wait(lock, [&]() { return !queue.empty() || busy == 0; });
+			if ( queue.empty() )
+			{
+				break;
+			}
+
+			auto file = queue.front();
+			queue.pop_front();
+			stack = includers[file];
+			++busy;
+			lock.unlock();
+
+			found.clear();
+
+			auto fileDir = paths.GetParent(file);
+
+			MappedFile contents;
+			if ( contents.Open(Files_.find(file)->second) )
+			{
+				ParseIncludes(contents.GetData(), contents.GetSize(), includes);
+
+				for ( auto& curInclude : includes )
+				{
+					auto size = found.size();
+
+					//Quoted: next to the including file, then next to every file above it.
+					if ( curInclude.Quoted_ )
+					{
+						auto target = paths.Intern(fileDir, curInclude.Name_);
+						if ( Files_.count(target) > 0 )
+						{
+							found.push_back(target);
+							continue;
+						}
+
+						for ( auto curDir : stack )
+						{
+							target = paths.Intern(curDir, curInclude.Name_);
+							if ( Files_.count(target) > 0 )
+							{
+								found.push_back(target);
+							}
+						}
+						if ( found.size() > size )
+						{
+							continue;
+						}
+					}
+
+					for ( auto curDir : IncludeDirs_ )
+					{
+						auto target = paths.Intern(curDir, curInclude.Name_);
+						if ( Files_.count(target) > 0 )
+						{
+							found.push_back(target);
+							break;
+						}
+					}
+
+					//Resolved nowhere: may be found through a directory the scan does not know, keep
+					//every file of that name.
+					if ( curInclude.Quoted_ && found.size() == size )
+					{
+						auto itor = byName.find(paths.GetName(paths.Intern(fileDir, curInclude.Name_)));
+						if ( itor != byName.end() )
+						{
+							found.insert(found.end(), itor->second.begin(), itor->second.end());
+						}
+					}
+				}
+			}
+
+			auto pos = std::lower_bound(stack.begin(), stack.end(), fileDir);
+			if ( pos == stack.end() || *pos != fileDir )
+			{
+				stack.insert(pos, fileDir);
+			}
+
+			lock.lock();
+			for ( auto curFound : found )
+			{
+				auto& curStack = includers[curFound];
+				auto grown = false;
+				for ( auto curDir : stack )
+				{
+					auto at = std::lower_bound(curStack.begin(), curStack.end(), curDir);
+					if ( at == curStack.end() || *at != curDir )
+					{
+						curStack.insert(at, curDir);
+						grown = true;
+					}
+				}
+
+				if ( ret.insert(curFound).second || grown )
+				{
+					queue.push_back(curFound);
+				}
+			}
+			--busy;
+			wakeUp.notify_all();
+		}
+	};
+
+	std::vector<std::thread> threads;
+	for ( unsigned index = 1; index < jobCount; ++index )
+	{
+		threads.emplace_back(worker);
+	}
+	worker();
+
+	for ( auto& curThread : threads )
+	{
+		curThread.join();
+	}
+
+	return ret;
+}
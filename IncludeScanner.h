@@ -0,0 +1,55 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include "PathTable.h"
+
+#include <string>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//Follows the #include directives of a project's sources to the files they reach. Works on
+//destination paths, the way the compiler will see the converted tree: a quoted include is
+//looked up next to the including file first, then next to the files that included it, then
+//in the include directories; one found nowhere keeps every file of its name. Only files
+//the project materializes are followed; the source of each is what gets read. Includes
+//written through a macro can not be followed, which is what keep patterns are for.
+class	IncludeScanner
+{
+public:
+
+	class	SInclude
+	{
+	public:
+		std::string	Name_;
+		bool		Quoted_ = false;
+		size_t		Line_ = 0;	//1-based.
+	};
+
+	//A file the project materializes at to, read from from.
+	void		AddFile(PathTable::ID to, const bfs::path& from);
+	void		AddIncludeDir(PathTable::ID dir);
+
+	//Files every scan starts from: the compiled sources and the kept headers.
+	void		AddRoot(PathTable::ID to);
+
+	//Destinations reachable from the roots, roots included. Files are read on jobCount
+	//threads; jobCount == 0 means one per hardware thread.
+	std::unordered_set<PathTable::ID>	Scan(unsigned jobCount = 0) const;
+
+	//Header-like files by extension (.h, .hpp, .inl, ...). Only these are ever pruned.
+	static	bool	IsHeader(const bfs::path& file);
+
+	//The #include directives of a file, in order. firstDefine, when given, receives the line
+	//of the first #define or #undef, 0 when there is none.
+	static	void	ParseIncludes(const char* data, size_t size, std::vector<SInclude>& includes, size_t* firstDefine = nullptr);
+
+private:
+
+	std::unordered_map<PathTable::ID, bfs::path>	Files_;
+	std::vector<PathTable::ID>	IncludeDirs_;
+	std::vector<PathTable::ID>	Roots_;
+};
@@ -0,0 +1,108 @@
+#include "MappedFile.h"
+
+#include <boost/filesystem.hpp>
+#include <boost/filesystem/fstream.hpp>
+
+#include <iterator>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile()
+{
+	Close();
+}
+
+void MappedFile::Close()
+{
+	if ( Mapped_ )
+	{
+#ifdef _WIN32
+		::UnmapViewOfFile(Data_);
+		::CloseHandle(Mapping_);
+		Mapping_ = nullptr;
+#else
+		::munmap(const_cast<char*>(Data_), Size_);
+#endif
+	}
+
+	Data_ = nullptr;
+	Size_ = 0;
+	Mapped_ = false;
+	Buffer_.clear();
+}
+
+bool MappedFile::Open(const bfs::path& file)
+{
+	Close();
+
+#ifdef _WIN32
+	auto handle = ::CreateFileW(file.wstring().c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+	if ( handle == INVALID_HANDLE_VALUE )
+	{
+		return false;
+	}
+
+	LARGE_INTEGER size;
+	if ( ::GetFileSizeEx(handle, &size) && size.QuadPart > 0 )
+	{
+		Mapping_ = ::CreateFileMappingW(handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+		if ( Mapping_ )
+		{
+			Data_ = static_cast<const char*>(::MapViewOfFile(Mapping_, FILE_MAP_READ, 0, 0, 0));
+			if ( Data_ )
+			{
+				Size_ = static_cast<size_t>(size.QuadPart);
+				Mapped_ = true;
+			}
+			else
+			{
+				::CloseHandle(Mapping_);
+				Mapping_ = nullptr;
+			}
+		}
+	}
+	::CloseHandle(handle);
+#else
+	auto fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+	if ( fd < 0 )
+	{
+		return false;
+	}
+
+	struct stat st;
+	if ( ::fstat(fd, &st) == 0 && st.st_size > 0 )
+	{
+		auto data = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+		if ( data != MAP_FAILED )
+		{
+			Data_ = static_cast<const char*>(data);
+			Size_ = static_cast<size_t>(st.st_size);
+			Mapped_ = true;
+		}
+	}
+	::close(fd);
+#endif
+
+	if ( Mapped_ )
+	{
+		return true;
+	}
+
+	bfs::ifstream ifs(file, std::ios::in | std::ios::binary);
+	if ( !ifs )
+	{
+		return false;
+	}
+
+	Buffer_.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+	Data_ = Buffer_.empty() ? nullptr : Buffer_.data();
+	Size_ = Buffer_.size();
+	return true;
+}
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <istream>
+#include <streambuf>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//Read-only view of a whole file. Mapped into memory where the platform allows it, read into a
+//buffer otherwise (empty files, file systems that refuse to map).
+class	MappedFile
+{
+public:
+
+	MappedFile() {}
+	~MappedFile();
+
+	//Returns false when the file can not be opened.
+	bool		Open(const bfs::path& file);
+
+	const char*	GetData() const { return Data_; }
+	size_t		GetSize() const { return Size_; }
+
+private:
+
+	MappedFile(const MappedFile&);
+	MappedFile&	operator=(const MappedFile&);
+
+	void		Close();
+
+	const char*	Data_ = nullptr;
+	size_t		Size_ = 0;
+	bool		Mapped_ = false;
+	std::vector<char>	Buffer_;
+#ifdef _WIN32
+	void*		Mapping_ = nullptr;
+#endif
+};
+
+//Drop-in for boost::filesystem::ifstream over a mapped file. The whole file is the get area,
+//so XmlReader walks the mapping directly instead of reading through a filebuf. A file that can
+//not be opened reads as empty and sets failbit, as ifstream does.
+class	MappedIStream : public std::istream
+{
+public:
+
+	explicit	MappedIStream(const bfs::path& file) : std::istream(nullptr)
+	{
+		auto opened = File_.Open(file);
+		auto data = const_cast<char*>(File_.GetData());
+		Buf_.SetData(data, data + File_.GetSize());
+
+		rdbuf(&Buf_);
+		if ( !opened )
+		{
+			setstate(std::ios::failbit);
+		}
+	}
+
+private:
+
+	class	SBuf : public std::streambuf
+	{
+	public:
+		void	SetData(char* begin, char* end) { setg(begin, begin, end); }
+	};
+
+	MappedFile	File_;
+	SBuf		Buf_;
+};
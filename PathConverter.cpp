@@ -0,0 +1,87 @@
+#include "PathConverter.h"
+
+PathTemplate::PathTemplate(const std::string& text)
+{
+	size_t pos = 0;
+	while ( pos < text.size() )
+	{
+		auto begin = text.find("$(", pos);
+		auto end = begin == std::string::npos ? std::string::npos : text.find(')', begin + 2);
+		if ( end == std::string::npos )
+		{
+			begin = text.size();
+		}
+
+		if ( begin > pos )
+		{
+			SSegment literal;
+			literal.Text_ = text.substr(pos, begin - pos);
+			LiteralSize_ += literal.Text_.size();
+			Segments_.push_back(literal);
+		}
+
+		if ( begin == text.size() )
+		{
+			break;
+		}
+
+		SSegment macro;
+		macro.Text_ = text.substr(begin + 2, end - begin - 2);
+		macro.Macro_ = true;
+		Segments_.push_back(macro);
+
+		pos = end + 1;
+	}
+}
+
+std::string PathTemplate::Expand(const MacroTable& macros) const
+{
+	std::string ret;
+	ret.reserve(LiteralSize_ + 64);
+
+	for ( auto& curSegment : Segments_ )
+	{
+		if ( !curSegment.Macro_ )
+		{
+			ret += curSegment.Text_;
+			continue;
+		}
+
+		auto itor = macros.find(curSegment.Text_);
+		if ( itor != macros.end() )
+		{
+			ret += itor->second;
+		}
+		else
+		{
+			ret += "$(";
+			ret += curSegment.Text_;
+			ret += ')';
+		}
+	}
+
+	return ret;
+}
+
+const PathConverter& PathConverter::GetInstance()
+{
+	static	PathConverter sIns;
+	return sIns;
+}
+
+std::string PathConverter::ConvertPath(const std::string& to, const MacroTable& macros) const
+{
+	const PathTemplate* compiled = nullptr;
+	{
+		std::lock_guard<std::mutex> lock(Mutex_);
+
+		auto itor = Templates_.find(to);
+		if ( itor == Templates_.end() )
+		{
+			itor = Templates_.emplace(to, PathTemplate(to)).first;
+		}
+		compiled = &itor->second;
+	}
+
+	return compiled->Expand(macros);
+}
@@ -0,0 +1,47 @@
+#pragma once
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+//Macro name (without "$(" and ")") to value, computed once per project.
+typedef	std::map<std::string, std::string>	MacroTable;
+
+//A To/Path template split once into literal text and macro references, so expanding it is a
+//single pass over the segments.
+class	PathTemplate
+{
+public:
+
+	explicit	PathTemplate(const std::string& text);
+
+	//Macros missing from the table, such as MSBuild's $(Configuration), are kept as written.
+	std::string	Expand(const MacroTable& macros) const;
+
+private:
+
+	class	SSegment
+	{
+	public:
+		std::string	Text_;
+		bool		Macro_ = false;
+	};
+
+	std::vector<SSegment>	Segments_;
+	size_t		LiteralSize_ = 0;
+};
+
+class	PathConverter
+{
+public:
+
+	static	const PathConverter&	GetInstance();
+
+	std::string	ConvertPath(const std::string& to, const MacroTable& macros) const;
+
+private:
+
+	mutable	std::mutex	Mutex_;
+	mutable	std::map<std::string, PathTemplate>	Templates_;
+};
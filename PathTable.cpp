@@ -0,0 +1,260 @@
+#include "PathTable.h"
+
+#include <algorithm>
+#include <cctype>
+#include <stdexcept>
+#include <vector>
+
+namespace
+{
+	inline	bool	IsSeparator(char value)
+	{
+		return value == '/' || value == '\\';
+	}
+
+#ifdef _WIN32
+	const char	sSeparator = '\\';
+#else
+	const char	sSeparator = '/';
+#endif
+}
+
+template<typename T>
+PathTable::SChunkList<T>::~SChunkList()
+{
+	for ( std::uint32_t index = 0; index < sMaxChunks; ++index )
+	{
+		delete[] Chunks_[index].load(std::memory_order_relaxed);
+	}
+}
+
+//Only called with the table's lock held, so Size_ is not raced by another writer.
+template<typename T>
+std::uint32_t PathTable::SChunkList<T>::Append(const T& value)
+{
+	auto size = Size_.load(std::memory_order_relaxed);
+	if ( (size & (sChunkSize - 1)) == 0 )
+	{
+		if ( (size >> sChunkBits) >= sMaxChunks )
+		{
+			throw std::length_error("Too many paths");
+		}
+		Chunks_[size >> sChunkBits].store(new T[sChunkSize], std::memory_order_release);
+	}
+
+	auto chunk = Chunks_[size >> sChunkBits].load(std::memory_order_relaxed);
+
+	chunk[size & (sChunkSize - 1)] = value;
+	Size_.store(size + 1, std::memory_order_release);
+	return size;
+}
+
+PathTable::PathTable()
+{
+	//Node 0 is the empty path, name 0 the empty name.
+	Names_.Append(std::string());
+	NameIDs_.emplace(std::string(), 0);
+	Nodes_.Append(SNode());
+}
+
+PathTable& PathTable::GetInstance()
+{
+	static	PathTable	sIns;
+	return sIns;
+}
+
+PathTable::ID PathTable::GetChild(ID parent, const std::string& name, bool root)
+{
+#ifdef _WIN32
+	auto key = name;
+	std::transform(key.begin(), key.end(), key.begin(), [](char value) { return static_cast<char>(std::tolower(static_cast<unsigned char>(value))); });
+#else
+	auto& key = name;
+#endif
+
+	auto nameItor = NameIDs_.find(key);
+	if ( nameItor == NameIDs_.end() )
+	{
+		nameItor = NameIDs_.emplace(key, Names_.Append(name)).first;
+	}
+
+	auto childKey = (static_cast<std::uint64_t>(parent) << 32) | nameItor->second;
+	auto childItor = Children_.find(childKey);
+	if ( childItor != Children_.end() )
+	{
+		return childItor->second;
+	}
+
+	SNode node;
+	node.Parent_ = parent;
+	node.Name_ = nameItor->second;
+	node.Depth_ = Nodes_[parent].Depth_ + 1;
+	node.Root_ = root;
+
+	auto ret = Nodes_.Append(node);
+	Children_.emplace(childKey, ret);
+	return ret;
+}
+
+PathTable::ID PathTable::Intern(const bfs::path& path)
+{
+	return Intern(sEmpty, path.string());
+}
+
+PathTable::ID PathTable::Intern(ID base, const std::string& text)
+{
+	std::lock_guard<std::mutex> lock(Mutex_);
+
+	auto ret = base;
+	size_t pos = 0;
+
+	//Absolute paths start at their root: "C:" and/or a separator. "C:" is a plain name elsewhere.
+#ifdef _WIN32
+	if ( text.size() >= 2 && text[1] == ':' && std::isalpha(static_cast<unsigned char>(text[0])) )
+	{
+		ret = GetChild(sEmpty, text.substr(0, 2), true);
+		pos = 2;
+		if ( pos < text.size() && IsSeparator(text[pos]) )
+		{
+			ret = GetChild(ret, "/", true);
+		}
+	}
+	else
+#endif
+	if ( !text.empty() && IsSeparator(text[0]) )
+	{
+		ret = GetChild(sEmpty, "/", true);
+	}
+
+	std::string name;
+	while ( pos < text.size() )
+	{
+		auto end = pos;
+		while ( end < text.size() && !IsSeparator(text[end]) )
+		{
+			++end;
+		}
+
+		name.assign(text, pos, end - pos);
+		pos = end + 1;
+
+		if ( name.empty() || name == "." )
+		{
+			continue;
+		}
+
+		//".." removes its parent, unless there is nothing left to remove.
+		if ( name == ".." && ret != sEmpty && !Nodes_[ret].Root_ && GetName(ret) != ".." )
+		{
+			ret = Nodes_[ret].Parent_;
+			continue;
+		}
+
+		ret = GetChild(ret, name);
+	}
+
+	return ret;
+}
+
+bool PathTable::IsWithin(ID path, ID prefix) const
+{
+	auto prefixDepth = GetDepth(prefix);
+	while ( GetDepth(path) > prefixDepth )
+	{
+		path = GetParent(path);
+	}
+
+	return path == prefix;
+}
+
+PathTable::ID PathTable::Rebase(ID path, ID fromRoot, ID toRoot)
+{
+	std::vector<ID> below;
+	for ( ; path != fromRoot && path != sEmpty; path = GetParent(path) )
+	{
+		below.push_back(path);
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex_);
+
+	auto ret = toRoot;
+	for ( auto itor = below.rbegin(); itor != below.rend(); ++itor )
+	{
+		ret = GetChild(ret, GetName(*itor));
+	}
+	return ret;
+}
+
+std::string PathTable::Relative(ID from, ID to) const
+{
+	auto common = from;
+	auto other = to;
+	while ( GetDepth(common) > GetDepth(other) )
+	{
+		common = GetParent(common);
+	}
+	while ( GetDepth(other) > GetDepth(common) )
+	{
+		other = GetParent(other);
+	}
+	while ( common != other )
+	{
+		common = GetParent(common);
+		other = GetParent(other);
+	}
+
+	std::string ret;
+	for ( auto node = from; node != common; node = GetParent(node) )
+	{
+		if ( !ret.empty() )
+		{
+			ret += sSeparator;
+		}
+		ret += "..";
+	}
+
+	std::vector<ID> below;
+	for ( auto node = to; node != common; node = GetParent(node) )
+	{
+		below.push_back(node);
+	}
+
+	for ( auto itor = below.rbegin(); itor != below.rend(); ++itor )
+	{
+		if ( !ret.empty() )
+		{
+			ret += sSeparator;
+		}
+		ret += GetName(*itor);
+	}
+
+	return ret;
+}
+
+std::string PathTable::ToString(ID path) const
+{
+	std::vector<ID> nodes;
+	for ( ; path != sEmpty; path = GetParent(path) )
+	{
+		nodes.push_back(path);
+	}
+
+	std::string ret;
+	for ( auto itor = nodes.rbegin(); itor != nodes.rend(); ++itor )
+	{
+		auto& name = GetName(*itor);
+		if ( name == "/" )
+		{
+			ret += sSeparator;
+			continue;
+		}
+
+		if ( !ret.empty() && ret.back() != sSeparator )
+		{
+			ret += sSeparator;
+		}
+		ret += name;
+	}
+
+	return ret;
+}
@@ -0,0 +1,99 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace bfs = boost::filesystem;
+
+//Every path the converter works with, interned once. A path is the ID of its last component
+//in a tree of (parent, component) nodes: equal paths get equal IDs, prefix and relative path
+//queries walk up the tree, and a directory is stored once however many files lie below it.
+//Both '/' and '\' separate components, "." and ".." are resolved lexically and on Windows
+//components compare case-insensitively, keeping the first spelling seen.
+//Interning takes a lock; reading an interned path does not.
+class	PathTable
+{
+public:
+
+	typedef	std::uint32_t	ID;
+
+	//The empty path. Relative paths start below it, as do the roots ("/", and "C:" on Windows)
+	//of absolute ones.
+	static	const ID	sEmpty = 0;
+
+	static	PathTable&	GetInstance();
+
+	ID		Intern(const bfs::path& path);
+
+	//text resolved against the directory base, unless text is absolute.
+	ID		Intern(ID base, const std::string& text);
+
+	ID		GetParent(ID path) const { return Nodes_[path].Parent_; }
+	size_t	GetDepth(ID path) const { return Nodes_[path].Depth_; }
+	const std::string&	GetName(ID path) const { return Names_[Nodes_[path].Name_]; }
+
+	//Whether path is prefix itself or lies below it.
+	bool	IsWithin(ID path, ID prefix) const;
+
+	//path, which lies within fromRoot, moved to the same place below toRoot.
+	ID		Rebase(ID path, ID fromRoot, ID toRoot);
+
+	//How to reach to from the directory from, with native separators. Empty when they are equal.
+	std::string	Relative(ID from, ID to) const;
+
+	std::string	ToString(ID path) const;
+	bfs::path	ToPath(ID path) const { return ToString(path); }
+
+private:
+
+	PathTable();
+	PathTable(const PathTable&);
+	PathTable&	operator=(const PathTable&);
+
+	class	SNode
+	{
+	public:
+		ID				Parent_ = sEmpty;
+		std::uint32_t	Name_ = 0;
+		std::uint32_t	Depth_ = 0;
+		bool			Root_ = false;
+	};
+
+	//Grows in fixed chunks that never move, so readers need no lock while a writer appends. The
+	//writer publishes a chunk and then the size with release stores; readers load them acquiring.
+	template<typename T>
+	class	SChunkList
+	{
+	public:
+
+		SChunkList() : Chunks_(new std::atomic<T*>[sMaxChunks]()), Size_(0) {}
+		~SChunkList();
+
+		const T&	operator[](std::uint32_t index) const { return Chunks_[index >> sChunkBits].load(std::memory_order_acquire)[index & (sChunkSize - 1)]; }
+		std::uint32_t	Size() const { return Size_.load(std::memory_order_acquire); }
+		std::uint32_t	Append(const T& value);
+
+	private:
+
+		static	const std::uint32_t	sChunkBits = 12;
+		static	const std::uint32_t	sChunkSize = 1 << sChunkBits;
+		static	const std::uint32_t	sMaxChunks = 1 << 16;
+
+		std::unique_ptr<std::atomic<T*>[]>	Chunks_;
+		std::atomic<std::uint32_t>	Size_;
+	};
+
+	ID		GetChild(ID parent, const std::string& name, bool root = false);
+
+	std::mutex	Mutex_;
+	SChunkList<SNode>	Nodes_;
+	SChunkList<std::string>	Names_;
+	std::unordered_map<std::string, std::uint32_t>	NameIDs_;	//Folded on Windows.
+	std::unordered_map<std::uint64_t, ID>	Children_;			//(parent, name) -> child
+};
@@ -0,0 +1,113 @@
+#include "PchPlanner.h"
+#include "IncludeScanner.h"
+#include "MappedFile.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+#include <unordered_set>
+
+PchPlanner::PchPlanner(size_t maxHeaders, double minShare) : MaxHeaders_(maxHeaders), MinShare_(minShare)
+{
+}
+
+void PchPlanner::AddSource(const std::string& include, const bfs::path& from)
+{
+	SSource source;
+	source.Include_ = include;
+
+	MappedFile contents;
+	if ( contents.Open(from) )
+	{
+		std::vector<IncludeScanner::SInclude> includes;
+		IncludeScanner::ParseIncludes(contents.GetData(), contents.GetSize(), includes, &source.FirstDefine_);
+
+		for ( auto& curInclude : includes )
+		{
+			if ( !curInclude.Quoted_ )
+			{
+				source.Headers_.emplace_back(curInclude.Name_, curInclude.Line_);
+			}
+		}
+	}
+
+	Sources_.push_back(source);
+}
+
+void PchPlanner::Choose(const std::function<bool(const std::string&)>& isStable)
+{
+	Headers_.clear();
+
+	//Counts sources, not includes: a header named twice by one source counts once.
+	std::vector<std::string> order;
+	std::unordered_map<std::string, size_t> counts;
+	for ( auto& curSource : Sources_ )
+	{
+		std::unordered_set<std::string> seen;
+		for ( auto& curHeader : curSource.Headers_ )
+		{
+			if ( seen.insert(curHeader.first).second && counts[curHeader.first]++ == 0 )
+			{
+				order.push_back(curHeader.first);
+			}
+		}
+	}
+
+	auto minCount = std::max<size_t>(2, static_cast<size_t>(std::ceil(MinShare_ * Sources_.size())));
+
+	std::vector<std::string> candidates;
+	for ( auto& curHeader : order )
+	{
+		if ( counts[curHeader] >= minCount && isStable(curHeader) )
+		{
+			candidates.push_back(curHeader);
+		}
+	}
+
+	if ( candidates.size() > MaxHeaders_ )
+	{
+		std::vector<std::string> common = candidates;
+		std::stable_sort(common.begin(), common.end(), [&](const std::string& left, const std::string& right) { return counts[left] > counts[right]; });
+		common.resize(MaxHeaders_);
+
+		std::unordered_set<std::string> keep(common.begin(), common.end());
+		candidates.erase(std::remove_if(candidates.begin(), candidates.end(), [&](const std::string& header) { return keep.count(header) == 0; }), candidates.end());
+	}
+
+	Headers_ = candidates;
+}
+
+std::vector<std::string> PchPlanner::GetConflicts() const
+{
+	std::unordered_set<std::string> chosen(Headers_.begin(), Headers_.end());
+
+	std::vector<std::string> ret;
+	for ( auto& curSource : Sources_ )
+	{
+		if ( curSource.FirstDefine_ == 0 )
+		{
+			continue;
+		}
+
+		for ( auto& curHeader : curSource.Headers_ )
+		{
+			if ( curHeader.second > curSource.FirstDefine_ && chosen.count(curHeader.first) > 0 )
+			{
+				ret.push_back(curSource.Include_);
+				break;
+			}
+		}
+	}
+
+	return ret;
+}
+
+std::string PchPlanner::MakeHeaderText() const
+{
+	std::string ret = "//Generated by ProjConvertor. Do not edit.\n#pragma once\n";
+	for ( auto& curHeader : Headers_ )
+	{
+		ret += "#include <" + curHeader + ">\n";
+	}
+	return ret;
+}
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//Chooses a project's precompiled header from the headers its C++ sources include most. Only
+//<> includes the caller calls stable are taken: headers of the project itself change too
+//often to be worth rebuilding the precompiled header for.
+class	PchPlanner
+{
+public:
+
+	PchPlanner(size_t maxHeaders, double minShare);
+
+	//Reads a source. include is how the project names it.
+	void		AddSource(const std::string& include, const bfs::path& from);
+
+	//Picks the headers included by at least minShare of the sources, and by two at least, the
+	//most common first up to maxHeaders. They are listed in the order the sources include them.
+	void		Choose(const std::function<bool(const std::string&)>& isStable);
+
+	const std::vector<std::string>&	GetHeaders() const { return Headers_; }
+	size_t		GetSourceCount() const { return Sources_.size(); }
+
+	//Sources that define or undefine a macro before including one of the chosen headers. A
+	//forced include would give them the header as configured without it.
+	std::vector<std::string>	GetConflicts() const;
+
+	//The generated header: #pragma once and one #include per chosen header.
+	std::string	MakeHeaderText() const;
+
+private:
+
+	class	SSource
+	{
+	public:
+		std::string	Include_;
+		std::vector<std::pair<std::string, size_t>>	Headers_;	//<> includes and their lines.
+		size_t		FirstDefine_ = 0;
+	};
+
+	size_t		MaxHeaders_;
+	double		MinShare_;
+	std::vector<SSource>	Sources_;
+	std::vector<std::string>	Headers_;
+};
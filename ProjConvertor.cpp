@@ -1,133 +1,117 @@
 #include "ProjConvertor.h"
+#include "ContentStore.h"
+#include "DirWalker.h"
+#include "IncludeScanner.h"
+#include "MappedFile.h"
+#include "PchPlanner.h"
+#include "SemicolonList.h"
+#include "TarWriter.h"
+#include "UnityBuild.h"
+#include "XmlStream.h"
 
-#include <boost/property_tree/xml_parser.hpp>
 #include <boost/algorithm/string.hpp>
-#include <boost/range.hpp>
 
+#include <algorithm>
+#include <iomanip>
 #include <iostream>
 #include <map>
-#include <functional>
+#include <memory>
+#include <sstream>
+#include <unordered_set>
 
-class	PathConverter
+bfs::path RelativeTo(const bfs::path& from, const bfs::path& to)
 {
-public:
-
-	PathConverter()
-	{
-		{//TargetName
-			auto ftr = [](const SProjectInfo& projInfo)
-			{
-				return projInfo.TargetName;
-			};
-
-			ConverterMap_.emplace("$(TargetName)", ftr);
-		}
-
-		{//ProjectBuildPath
-			auto ftr = [](const SProjectInfo& projInfo)
-			{
-				return projInfo.ProjectBuildPath.string() + "\\";
-			};
+	auto& paths = PathTable::GetInstance();
+	return paths.Relative(paths.Intern(from), paths.Intern(to));
+}
 
-			ConverterMap_.emplace("$(ProjectBuildPath)", ftr);
-		}
+std::string ToFileText(const std::string& text)
+{
+#ifdef _WIN32
+	return boost::replace_all_copy(text, "\n", "\r\n");
+#else
+	return text;
+#endif
+}
 
-		{//VCXProjectPath
-			auto ftr = [](const SProjectInfo& projInfo)
-			{
-				return projInfo.VCXProjectPath.To_.string() + "\\";
-			};
+bool WriteIfChanged(const bfs::path& file, const std::string& data, bool* changed)
+{
+	if ( changed )
+	{
+		*changed = false;
+	}
 
-			ConverterMap_.emplace("$(VCXProjectPath)", ftr);
+	{
+		MappedFile current;
+		if ( current.Open(file) && current.GetSize() == data.size() && std::equal(data.begin(), data.end(), current.GetData()) )
+		{
+			return true;
 		}
 	}
 
-	static	const PathConverter&	GetInstance()
+	if ( file.has_parent_path() )
 	{
-		static	PathConverter sIns;
-		return sIns;
+		bfs::create_directories(file.parent_path());
 	}
 
-	std::string	ConvertPath(const std::string& to, const SProjectInfo& projInfo) const
+	auto tmpFile = file;
+	tmpFile += ".tmp";
 	{
-		auto ret = to;
-		for ( auto& curConvert : ConverterMap_ )
+		bfs::ofstream ofs(tmpFile, std::ios::out | std::ios::trunc | std::ios::binary);
+		ofs.write(data.data(), static_cast<std::streamsize>(data.size()));
+		if ( !ofs )
 		{
-			auto toFind = curConvert.first;
-			auto repleace = curConvert.second(projInfo);
-			boost::algorithm::replace_all(ret, toFind, repleace);
+			ofs.close();
+			boost::system::error_code ec;
+			bfs::remove(tmpFile, ec);
+			std::cerr << "Can not write " << tmpFile << std::endl;
+			return false;
 		}
-
-		return ret;
 	}
 
-private:
-
-	typedef	std::function<std::string(const SProjectInfo&)>	Converter;
-	std::map<std::string, Converter>	ConverterMap_;
-};
-
-bfs::path RelativeTo(const bfs::path& from, const bfs::path& to)
-{
-	// Start at the root path and while they are the same then do nothing then when they first
-	// diverge take the remainder of the two path and replace the entire from path with ".."
-	// segments.
-	auto cpyFrom = from;
-	auto cpyTo = to;
-	cpyFrom.remove_trailing_separator();
-	cpyTo.remove_trailing_separator();
+	bfs::rename(tmpFile, file);
 
-	auto fromIter = cpyFrom.begin();
-	auto toIter = cpyTo.begin();
-
-	// Loop through both
-	while ( fromIter != cpyFrom.end() && toIter != cpyTo.end() && (*toIter) == (*fromIter) )
+	if ( changed )
 	{
-		++toIter;
-		++fromIter;
+		*changed = true;
 	}
+	return true;
+}
 
-	bfs::path finalPath;
-	while ( fromIter != cpyFrom.end() )
+//Hashes an element with its attributes and children, in document order.
+std::uint64_t	HashConfigNode(const XmlDocument::SNode& node, std::uint64_t seed)
+{
+	auto ret = ContentStore::Hash(node.Name_.Data_, node.Name_.Size_, seed);
+	for ( auto curAttribute = node.FirstAttribute_; curAttribute; curAttribute = curAttribute->Next_ )
 	{
-		if ( !(finalPath.empty() && *fromIter == ".") )
-		{
-			finalPath /= "..";
-		}
-
-		++fromIter;
+		ret = ContentStore::Hash(curAttribute->Name_.Data_, curAttribute->Name_.Size_, ret);
+		ret = ContentStore::Hash(curAttribute->Value_.Data_, curAttribute->Value_.Size_, ret);
 	}
-	
-	while ( toIter != cpyTo.end() )
-	{
-		if ( *toIter != "." )
-		{
-			finalPath /= *toIter;
-		}
+	ret = ContentStore::Hash(node.Value_.Data_, node.Value_.Size_, ret);
 
-		++toIter;
+	//Children are bracketed, so moving one into its sibling changes the hash.
+	for ( auto curChild = node.FirstChild_; curChild; curChild = curChild->Next_ )
+	{
+		ret = HashConfigNode(*curChild, ret + 1);
 	}
-
-	return finalPath;
+	return ret + 2;
 }
 
-ProjectList	ReadConfig()
+ProjectList	ReadConfig(const bfs::path& cfgFile)
 {
 	ProjectList ret;
 
-	bfs::path cfgFile = "config.xml";
 	if ( !bfs::exists(cfgFile) )
 	{
 		std::cerr << "Need Config File." << std::endl;
 		return ret;
 	}
 
-	boost::filesystem::ifstream configIfs(cfgFile);
-	boost::property_tree::ptree configXml;
+	XmlDocument configXml;
 
 	try
 	{
-		boost::property_tree::read_xml(configIfs, configXml, xml_parser::no_comments | xml_parser::trim_whitespace);
+		configXml.Load(cfgFile);
 	}
 	catch ( std::exception& exp )
 	{
@@ -135,29 +119,40 @@ ProjectList	ReadConfig()
 		return ret;
 	}
 
-	for ( auto& curProject : configXml )
+	for ( auto curProject = configXml.GetRoot().FirstChild_; curProject; curProject = curProject->Next_ )
 	{
-		if ( curProject.first != "Project" )
+		if ( curProject->Name_ != "Project" )
 		{
 			continue;
 		}
 
-		auto& curXML = curProject.second;
+		auto& curXML = *curProject;
 
 		SProjectInfo projInfo;
+		projInfo.ConfigHash = HashConfigNode(curXML, 0);
 
 		{//TargetName
-			auto targetName = curXML.get_optional<std::string>("<xmlattr>.TargetName");
+			auto targetName = curXML.GetAttribute("TargetName");
 			if ( !targetName )
 			{
 				std::cerr << "Need Target Name." << std::endl;
 				return ret;
 			}
 			projInfo.TargetName = *targetName;
+			projInfo.Macros["TargetName"] = projInfo.TargetName;
+		}
+
+		{//DependsOn
+			auto dependsOn = curXML.GetAttribute("DependsOn");
+			if ( dependsOn )
+			{
+				boost::algorithm::split(projInfo.DependsOn, *dependsOn, boost::algorithm::is_any_of(";"), boost::algorithm::token_compress_on);
+				projInfo.DependsOn.erase(std::remove(projInfo.DependsOn.begin(), projInfo.DependsOn.end(), ""), projInfo.DependsOn.end());
+			}
 		}
 
 		{//ProjectBuildPath
-			auto projPath = curXML.get_optional<std::string>("ProjectBuildPath.<xmlattr>.Path");
+			auto projPath = curXML.GetAttribute("ProjectBuildPath", "Path");
 			if ( !projPath )
 			{
 				std::cerr << "Need Project Path." << std::endl;
@@ -165,41 +160,124 @@ ProjectList	ReadConfig()
 			}
 			projInfo.ProjectBuildPath = bfs::system_complete(*projPath);
 			projInfo.ProjectBuildPath.remove_trailing_separator();
+			projInfo.Macros["ProjectBuildPath"] = projInfo.ProjectBuildPath.string() + "\\";
 		}
 
 		{//VCXProjectPath
-			auto vcxFromPath = curXML.get_optional<std::string>("VCXProjectPath.<xmlattr>.From");
-			auto vcxToPath = curXML.get_optional<std::string>("VCXProjectPath.<xmlattr>.To");
+			auto vcxFromPath = curXML.GetAttribute("VCXProjectPath", "From");
+			auto vcxToPath = curXML.GetAttribute("VCXProjectPath", "To");
 			if ( !vcxFromPath )
 			{
 				std::cerr << "Need Project Build Path." << std::endl;
 				return ret;
 			}
 			projInfo.VCXProjectPath.From_ = bfs::system_complete(*vcxFromPath);
-			projInfo.VCXProjectPath.To_ = bfs::system_complete(PathConverter::GetInstance().ConvertPath(*vcxToPath, projInfo));
+			projInfo.VCXProjectPath.To_ = bfs::system_complete(PathConverter::GetInstance().ConvertPath(*vcxToPath, projInfo.Macros));
 
 			projInfo.VCXProjectPath.From_.remove_trailing_separator();
 			projInfo.VCXProjectPath.To_.remove_trailing_separator();
+			projInfo.VCXProjectPath.FromID_ = PathTable::GetInstance().Intern(projInfo.VCXProjectPath.From_);
+			projInfo.VCXProjectPath.ToID_ = PathTable::GetInstance().Intern(projInfo.VCXProjectPath.To_);
+			projInfo.Macros["VCXProjectPath"] = projInfo.VCXProjectPath.To_.string() + "\\";
+		}
+
+		{//Macros
+			auto macros = curXML.GetChild("Macros");
+			if ( macros )
+			{
+				for ( auto curMacro = macros->FirstChild_; curMacro; curMacro = curMacro->Next_ )
+				{
+					auto name = curMacro->GetAttribute("Name");
+					auto value = curMacro->GetAttribute("Value");
+					if ( !name || !value )
+					{
+						continue;
+					}
+
+					if ( *name == "TargetName" || *name == "ProjectBuildPath" || *name == "VCXProjectPath" )
+					{
+						std::cerr << "Macro " << *name << " can not be redefined." << std::endl;
+						continue;
+					}
+
+					//A macro may use the built-in macros and the ones defined before it.
+					projInfo.Macros[*name] = PathConverter::GetInstance().ConvertPath(*value, projInfo.Macros);
+				}
+			}
+		}
+
+		{//Materialize
+			auto jobs = curXML.GetAttribute("Materialize", "Jobs");
+			if ( jobs )
+			{
+				projInfo.CopyJobs = static_cast<unsigned>(std::strtoul(jobs->c_str(), nullptr, 10));
+			}
+
+			auto incremental = curXML.GetAttribute("Materialize", "Incremental");
+			projInfo.IncrementalCopy = (incremental && *incremental == "True");
+
+			auto mode = curXML.GetAttribute("Materialize", "Mode");
+			if ( mode && !FileMaterializer::ParseMode(*mode, projInfo.MaterializeMode) )
+			{
+				std::cerr << "Unknown Materialize Mode " << *mode << "." << std::endl;
+				return ret;
+			}
+
+			auto store = curXML.GetAttribute("Materialize", "Store");
+			if ( store )
+			{
+				projInfo.StorePath = bfs::system_complete(PathConverter::GetInstance().ConvertPath(*store, projInfo.Macros));
+			}
+			else if ( projInfo.MaterializeMode == FileMaterializer::EMode::Store )
+			{
+				std::cerr << "Materialize Mode Store needs a Store path." << std::endl;
+				return ret;
+			}
+
+			auto backend = curXML.GetAttribute("Materialize", "Backend");
+			if ( backend )
+			{
+				if ( *backend == "IoUring" )
+				{
+					projInfo.UseIoUring = true;
+				}
+				else if ( *backend != "Sync" )
+				{
+					std::cerr << "Unknown Materialize Backend " << *backend << "." << std::endl;
+					return ret;
+				}
+			}
 		}
 
 		{//SrcDirectories
-			auto srcDirectories = curXML.get_child_optional("SrcDirectories");
+			auto srcDirectories = curXML.GetChild("SrcDirectories");
 			if ( srcDirectories )
 			{
-				for ( auto& curAdditionalDep : *srcDirectories )
+				for ( auto curAdditionalDep = srcDirectories->FirstChild_; curAdditionalDep; curAdditionalDep = curAdditionalDep->Next_ )
 				{
-					auto from = curAdditionalDep.second.get_optional<std::string>("<xmlattr>.From");
-					auto to = curAdditionalDep.second.get_optional<std::string>("<xmlattr>.To");
-					auto addToIncDir = curAdditionalDep.second.get_optional<std::string>("<xmlattr>.AddToIncludeDir");
+					auto from = curAdditionalDep->GetAttribute("From");
+					auto to = curAdditionalDep->GetAttribute("To");
+					auto addToIncDir = curAdditionalDep->GetAttribute("AddToIncludeDir");
+					auto mode = curAdditionalDep->GetAttribute("Mode");
 
 					SProjectInfo::SSrcDir newDir;
+					newDir.Mode_ = projInfo.MaterializeMode;
+					if ( mode && !FileMaterializer::ParseMode(*mode, newDir.Mode_) )
+					{
+						std::cerr << "Unknown Materialize Mode " << *mode << "." << std::endl;
+						return ret;
+					}
+
 					newDir.From_ = bfs::system_complete(*from);
-					newDir.To_ = bfs::system_complete(PathConverter::GetInstance().ConvertPath(*to, projInfo));
+					newDir.To_ = bfs::system_complete(PathConverter::GetInstance().ConvertPath(*to, projInfo.Macros));
 					newDir.AddToIncludeDir_ = (addToIncDir && *addToIncDir == "True");
 
 					newDir.From_.remove_trailing_separator();
 					newDir.To_.remove_trailing_separator();
+					newDir.FromID_ = PathTable::GetInstance().Intern(newDir.From_);
+					newDir.ToID_ = PathTable::GetInstance().Intern(newDir.To_);
 					projInfo.SrcList.push_back(newDir);
+					projInfo.SrcIndex.Add(newDir.FromID_, static_cast<int>(projInfo.SrcList.size() - 1));
 
 					if ( newDir.AddToIncludeDir_ )
 					{
@@ -210,45 +288,63 @@ ProjectList	ReadConfig()
 		}
 
 		{//AdditionalCopyFiles
-			auto additionalCopyFiles = curXML.get_child_optional("AdditionalCopyFiles");
+			auto additionalCopyFiles = curXML.GetChild("AdditionalCopyFiles");
 			if ( additionalCopyFiles )
 			{
-				for ( auto& curCpy : *additionalCopyFiles )
+				for ( auto curCpy = additionalCopyFiles->FirstChild_; curCpy; curCpy = curCpy->Next_ )
 				{
-					if ( curCpy.first == "File" )
+					auto mode = projInfo.MaterializeMode;
+					auto modeName = curCpy->GetAttribute("Mode");
+					if ( modeName && !FileMaterializer::ParseMode(*modeName, mode) )
+					{
+						std::cerr << "Unknown Materialize Mode " << *modeName << "." << std::endl;
+						return ret;
+					}
+
+					if ( curCpy->Name_ == "File" )
 					{
-						bfs::path file = curCpy.second.get<std::string>("<xmlattr>.From");
-						bfs::path to = PathConverter::GetInstance().ConvertPath(curCpy.second.get<std::string>("<xmlattr>.To"), projInfo);
+						//Completed like SrcDirectories: a SymLink output must not point relative to itself.
+						auto file = bfs::system_complete(curCpy->GetAttribute("From").get_value_or(std::string()));
+						bfs::path to = PathConverter::GetInstance().ConvertPath(curCpy->GetAttribute("To").get_value_or(std::string()), projInfo.Macros);
 						to = bfs::system_complete(to);
 
 						if ( bfs::exists(file) )
 						{
-							bfs::create_directories(to);
-							bfs::copy_file(file, to / file.filename(), bfs::copy_option::overwrite_if_exists);
+							FileMaterializer::SCopyItem item;
+							item.From_ = file;
+							item.To_ = to / file.filename();
+							item.Mode_ = mode;
+							projInfo.AdditionalCopyList.push_back(item);
 						}
 					}
-					else if ( curCpy.first == "Folder" )
+					else if ( curCpy->Name_ == "Folder" )
 					{
-						bfs::path folder = curCpy.second.get<std::string>("<xmlattr>.From");
-						bfs::path to = PathConverter::GetInstance().ConvertPath(curCpy.second.get<std::string>("<xmlattr>.To"), projInfo);
+						auto folder = bfs::system_complete(curCpy->GetAttribute("From").get_value_or(std::string()));
+						bfs::path to = PathConverter::GetInstance().ConvertPath(curCpy->GetAttribute("To").get_value_or(std::string()), projInfo.Macros);
 						to = bfs::system_complete(to);
 
-						if ( bfs::is_directory(folder) && bfs::exists(folder) )
+						if ( bfs::is_directory(folder) )
 						{
-							auto itor = bfs::recursive_directory_iterator(folder);
-							auto end = bfs::recursive_directory_iterator();
-							for ( auto& curFile : boost::make_iterator_range(itor, end) )
+							//Include="*.h;*.inl" Exclude="*.obj;CMakeFiles"
+							SProjectInfo::SCopyFolder copyFolder;
+							copyFolder.From_ = folder;
+							copyFolder.To_ = to;
+							copyFolder.Include_ = SemicolonList(curCpy->GetAttribute("Include").get_value_or(std::string())).GetItems();
+							copyFolder.Exclude_ = SemicolonList(curCpy->GetAttribute("Exclude").get_value_or(std::string())).GetItems();
+							copyFolder.Mode_ = mode;
+							projInfo.AdditionalCopyFolders.push_back(copyFolder);
+
+							DirWalker walker;
+							walker.SetFilter(copyFolder.Include_, copyFolder.Exclude_);
+
+							for ( auto& curFile : walker.Walk(folder, projInfo.CopyJobs) )
 							{
-								if ( bfs::is_directory(curFile) )
-								{
-									continue;
-								}
-
-								auto newPath = to / RelativeTo(folder, curFile);
-								bfs::create_directories(newPath.parent_path());
-								bfs::copy_file(curFile, newPath, bfs::copy_option::overwrite_if_exists);
+								FileMaterializer::SCopyItem item;
+								item.From_ = curFile.Path_;
+								item.To_ = to / curFile.RelPath_;
+								item.Mode_ = mode;
+								projInfo.AdditionalCopyList.push_back(item);
 							}
-
 						}
 					}
 				}
@@ -256,18 +352,18 @@ ProjectList	ReadConfig()
 		}
 
 		{//IgnoreCustomBuild
-			auto ignoreCustomBuild = curXML.get_child_optional("IgnoreCustomBuild");
+			auto ignoreCustomBuild = curXML.GetChild("IgnoreCustomBuild");
 			if ( ignoreCustomBuild )
 			{
-				auto ignoreAll = (*ignoreCustomBuild).get_optional<std::string>("<xmlattr>.All");
+				auto ignoreAll = ignoreCustomBuild->GetAttribute("All");
 				if ( ignoreAll )
 				{
 					projInfo.IgnoreAllCustomBuild = *ignoreAll == "True";
 				}
 
-				for ( auto& curAdditionalDep : *ignoreCustomBuild )
+				for ( auto curAdditionalDep = ignoreCustomBuild->FirstChild_; curAdditionalDep; curAdditionalDep = curAdditionalDep->Next_ )
 				{
-					auto name = curAdditionalDep.second.get_optional<std::string>("<xmlattr>.Name");
+					auto name = curAdditionalDep->GetAttribute("Name");
 					if ( name )
 					{
 						projInfo.IgnoreCustomBuild.insert(*name);
@@ -276,25 +372,106 @@ ProjectList	ReadConfig()
 			}
 		}
 
-		auto additionalIncs = curXML.get_child_optional("AdditionalIncludeDirectories");
+		{//PruneIncludes
+			auto pruneIncludes = curXML.GetChild("PruneIncludes");
+			if ( pruneIncludes )
+			{
+				auto enabled = pruneIncludes->GetAttribute("Enabled");
+				projInfo.PruneIncludes = (enabled && *enabled == "True");
+
+				//<Item Pattern="**/config.h" />: kept even when nothing includes it.
+				for ( auto curKeep = pruneIncludes->FirstChild_; curKeep; curKeep = curKeep->Next_ )
+				{
+					auto pattern = curKeep->GetAttribute("Pattern");
+					if ( pattern )
+					{
+						projInfo.PruneKeep.push_back(*pattern);
+					}
+				}
+			}
+		}
+
+		{//UnityBuild
+			auto unityBuild = curXML.GetChild("UnityBuild");
+			auto enabled = curXML.GetAttribute("UnityBuild", "Enabled");
+			if ( unityBuild && enabled && *enabled == "True" )
+			{
+				auto batchSize = unityBuild->GetAttribute("BatchSize");
+				projInfo.UnityBatchSize = batchSize ? std::strtoul(batchSize->c_str(), nullptr, 10) : 16;
+				if ( projInfo.UnityBatchSize == 0 )
+				{
+					std::cerr << "UnityBuild BatchSize must be at least 1." << std::endl;
+					return ret;
+				}
+
+				//<Item Pattern="zip.c" />: compiled on its own, e.g. for clashing static symbols.
+				for ( auto curExclude = unityBuild->FirstChild_; curExclude; curExclude = curExclude->Next_ )
+				{
+					auto pattern = curExclude->GetAttribute("Pattern");
+					if ( pattern )
+					{
+						projInfo.UnityExclude.push_back(*pattern);
+					}
+				}
+			}
+		}
+
+		{//PrecompiledHeader
+			auto pch = curXML.GetChild("PrecompiledHeader");
+			auto enabled = curXML.GetAttribute("PrecompiledHeader", "Enabled");
+			if ( pch && enabled && *enabled == "True" )
+			{
+				projInfo.AutoPch = true;
+
+				auto maxHeaders = pch->GetAttribute("MaxHeaders");
+				if ( maxHeaders )
+				{
+					projInfo.PchMaxHeaders = std::strtoul(maxHeaders->c_str(), nullptr, 10);
+				}
+
+				auto minShare = pch->GetAttribute("MinShare");
+				if ( minShare )
+				{
+					projInfo.PchMinShare = std::strtod(minShare->c_str(), nullptr);
+				}
+
+				if ( projInfo.PchMaxHeaders == 0 || !(projInfo.PchMinShare > 0 && projInfo.PchMinShare <= 1) )
+				{
+					std::cerr << "PrecompiledHeader needs MaxHeaders of at least 1 and MinShare in (0, 1]." << std::endl;
+					return ret;
+				}
+
+				//<Item Pattern="legacy/**" />: compiled without the precompiled header.
+				for ( auto curExclude = pch->FirstChild_; curExclude; curExclude = curExclude->Next_ )
+				{
+					auto pattern = curExclude->GetAttribute("Pattern");
+					if ( pattern )
+					{
+						projInfo.PchExclude.push_back(*pattern);
+					}
+				}
+			}
+		}
+
+		auto additionalIncs = curXML.GetChild("AdditionalIncludeDirectories");
 		if ( additionalIncs )
 		{
-			for ( auto& curAdditionalInc : *additionalIncs )
+			for ( auto curAdditionalInc = additionalIncs->FirstChild_; curAdditionalInc; curAdditionalInc = curAdditionalInc->Next_ )
 			{
-				auto item = curAdditionalInc.second.get_optional<std::string>("<xmlattr>.Path");
+				auto item = curAdditionalInc->GetAttribute("Path");
 				if ( item )
 				{
-					projInfo.AdditionalIncludeDirectories.push_back(PathConverter::GetInstance().ConvertPath(*item, projInfo));
+					projInfo.AdditionalIncludeDirectories.push_back(PathConverter::GetInstance().ConvertPath(*item, projInfo.Macros));
 				}
 			}
 		}
 
-		auto additionalDepends = curXML.get_child_optional("AdditionalDependencies");
+		auto additionalDepends = curXML.GetChild("AdditionalDependencies");
 		if ( additionalDepends )
 		{
-			for ( auto& curAdditionalDep : *additionalDepends )
+			for ( auto curAdditionalDep = additionalDepends->FirstChild_; curAdditionalDep; curAdditionalDep = curAdditionalDep->Next_ )
 			{
-				auto item = curAdditionalDep.second.get_optional<std::string>("<xmlattr>.Path");
+				auto item = curAdditionalDep->GetAttribute("Path");
 				if ( item )
 				{
 					projInfo.AdditionalDependencies.push_back(*item);
@@ -302,12 +479,12 @@ ProjectList	ReadConfig()
 			}
 		}
 
-		auto additionalLibsDirs = curXML.get_child_optional("AdditionalLibraryDirectories");
+		auto additionalLibsDirs = curXML.GetChild("AdditionalLibraryDirectories");
 		if ( additionalLibsDirs )
 		{
-			for ( auto& curAdditionalLibDir : *additionalLibsDirs )
+			for ( auto curAdditionalLibDir = additionalLibsDirs->FirstChild_; curAdditionalLibDir; curAdditionalLibDir = curAdditionalLibDir->Next_ )
 			{
-				auto item = curAdditionalLibDir.second.get_optional<std::string>("<xmlattr>.Path");
+				auto item = curAdditionalLibDir->GetAttribute("Path");
 				if ( item )
 				{
 					projInfo.AdditionalLibraryDirectories.push_back(*item);
@@ -340,324 +517,465 @@ bool CheckConfig(const SProjectInfo& projInfo)
 	return true;
 }
 
-bool	BuildVCXPROJ(const SProjectInfo& projInfo)
+//ReadProjectReferences without the fingerprint: parses the .vcxproj.
+std::vector<std::string>	ParseProjectReferences(const SProjectInfo& projInfo)
 {
-	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+	std::vector<std::string> ret;
 
-	ptree rawProjXml, outputProjXml;
-
-	try
-	{
-		boost::filesystem::fstream projIfs(projFileName);
-		boost::property_tree::read_xml(projIfs, rawProjXml, xml_parser::no_comments | xml_parser::trim_whitespace);
-	}
-	catch ( std::exception& exp )
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+	if ( !bfs::exists(projFileName) )
 	{
-		std::cerr << exp.what() << std::endl;
-		return false;
+		return ret;
 	}
 
-	auto projItems = rawProjXml.get_child_optional("Project");
-	if ( !projItems )
+	try
 	{
-		std::cerr << "Can not find <Project>." << std::endl;
-		return false;
-	}
+		XmlDocument projXml;
+		projXml.Load(projFileName);
 
-	for ( auto& curSrcDir : projInfo.SrcList )
-	{
-		if ( bfs::exists(curSrcDir.To_) )
+		auto project = projXml.GetRoot().FirstChild_;
+		if ( !project || project->Name_ != "Project" )
 		{
-			//bfs::remove_all(curSrcDir.To_);
+			return ret;
 		}
 
-		bfs::create_directories(curSrcDir.To_);
-	}
-
-	for ( auto& curProjItem : *projItems )
-	{
-		if ( curProjItem.first == "PropertyGroup" )
+		for ( auto curGroup = project->FirstChild_; curGroup; curGroup = curGroup->Next_ )
 		{
-			auto outDir = curProjItem.second.get_optional<std::string>("OutDir");
-			if ( !outDir )
+			if ( curGroup->Name_ != "ItemGroup" )
 			{
-				outputProjXml.add_child("Project." + curProjItem.first, curProjItem.second);
 				continue;
 			}
 
-			ptree tmpPG;
-			for ( auto& curPropertyGroupItem : curProjItem.second )
+			for ( auto curItem = curGroup->FirstChild_; curItem; curItem = curItem->Next_ )
 			{
-				if ( curPropertyGroupItem.first == "OutDir" )
+				if ( curItem->Name_ != "ProjectReference" )
 				{
-					auto dir = curPropertyGroupItem.second.get_value<std::string>();
-					ptree outDir;
-					outDir.add_child("<xmlattr>", curPropertyGroupItem.second.get_child("<xmlattr>"));
-					outDir.put_value(R"($(SolutionDir)build\bin\$(Configuration)\$(Platform)\$(PlatformToolset)\)");
-
-					tmpPG.add_child(curPropertyGroupItem.first, outDir);
+					continue;
 				}
-				else if ( curPropertyGroupItem.first == "IntDir" )
-				{
-					auto dir = curPropertyGroupItem.second.get_value<std::string>();
-					ptree intDir;
-					intDir.add_child("<xmlattr>", curPropertyGroupItem.second.get_child("<xmlattr>"));
-					intDir.put_value(R"($(SolutionDir)build\obj\$(ProjectName)\$(Configuration)\$(Platform)\$(PlatformToolset)\)");
 
-					tmpPG.add_child(curPropertyGroupItem.first, intDir);
-				}
-				else if ( curPropertyGroupItem.first != "TargetName" )
+				auto name = curItem->GetChild("Name");
+				if ( name )
 				{
-					tmpPG.add_child(curPropertyGroupItem.first, curPropertyGroupItem.second);
+					ret.push_back(name->Value_.str());
+					continue;
 				}
+
+				//The Include is a Windows path; take its file name without the extension.
+				auto include = curItem->GetAttribute("Include").get_value_or(std::string());
+				auto fileName = include.substr(include.find_last_of("\\/") + 1);
+				ret.push_back(fileName.substr(0, fileName.rfind('.')));
 			}
-			outputProjXml.add_child("Project.PropertyGroup", tmpPG);
 		}
-		else if ( curProjItem.first == "ItemDefinitionGroup" )
-		{
-			ptree tmpIDG;
-			//tmpIDG.add_child("<xmlattr>", curProjItem.second.get_child("<xmlattr>"));
+	}
+	catch ( std::exception& )
+	{
+	}
 
-			static std::regex rg(R"((.+?)(;|$))");
+	return ret;
+}
 
-			for ( auto& curIDGItem : curProjItem.second )
-			{
-				//curIDGItem.first will be "ClCompile"/"ResourceCompile"/"Midl"/"Link"/"ProjectReference"
+SResolvedFile	ResolveFile(const SProjectInfo& projInfo, const std::string& include)
+{
+	PhaseTimer timer(projInfo.Report, ProjectReport::EPhase::ResolvePath);
 
-				for ( auto& curID : curIDGItem.second )
-				{
-					if ( curID.first == "AdditionalIncludeDirectories" )
-					{
-						std::string finalStr;
-						for ( auto& curStr : projInfo.AdditionalIncludeDirectories )
-						{
-							finalStr += curStr + ";";
-						}
-						finalStr += "%(AdditionalIncludeDirectories)";
+	//Interned against the project directory: a directory shared by many items is split,
+	//normalized and compared once, and matching a root is a walk up the file's parents.
+	auto& paths = PathTable::GetInstance();
+	auto file = paths.Intern(projInfo.VCXProjectPath.FromID_, include);
 
-						tmpIDG.add(curIDGItem.first + "." + curID.first, finalStr);
-					}
-					else if ( curID.first == "PreprocessorDefinitions" )
-					{
-						auto rawStr = curID.second.get_value<std::string>();
+	SResolvedFile ret;
+	ret.From_ = paths.ToPath(file);
 
-						std::sregex_iterator itor(rawStr.begin(), rawStr.end(), rg), itorEnd;
+	auto dirIndex = projInfo.SrcIndex.Find(file);
+	if ( dirIndex != -1 )
+	{
+		auto& srcDir = projInfo.SrcList[dirIndex];
+		auto copyPath = paths.Rebase(file, srcDir.FromID_, srcDir.ToID_);
+		ret.CopyPath_ = paths.ToPath(copyPath);
+		ret.Include_ = paths.Relative(projInfo.VCXProjectPath.ToID_, copyPath);
+		ret.Mode_ = srcDir.Mode_;
+		ret.SrcDir_ = dirIndex;
+		return ret;
+	}
 
-						std::string finalStr;
-						for ( auto& curStr : boost::make_iterator_range(itor, itorEnd) )
-						{
-							auto predef = curStr.str(1);
-							//if ( predef != "BOOST_ALL_NO_LIB" )
-							{
-								finalStr += curStr.str(1) + ";";
-							}
-						}
+	if ( projInfo.Report )
+	{
+		projInfo.Report->Add(ProjectReport::ECounter::ResolvedToOther);
+	}
 
-						finalStr.erase(finalStr.size() - 1);
+	ret.CopyPath_ = projInfo.VCXProjectPath.To_ / "../Other/" / paths.GetName(file);
+	ret.Include_ = "../Other/" + paths.GetName(file);
+	ret.Mode_ = projInfo.MaterializeMode;
+	return ret;
+}
 
-						tmpIDG.add(curIDGItem.first + "." + curID.first, finalStr);
-					}
-					else if ( curID.first == "AdditionalDependencies" )
-					{
-						std::string finalStr;
-						for ( auto& curStr : projInfo.AdditionalDependencies )
-						{
-							finalStr += curStr + ";";
-						}
-						finalStr += "%(AdditionalDependencies)";
+//Config glob patterns match the file name, or the source path when they contain '/'.
+bool	MatchesAny(const SProjectInfo::Vector& patterns, const bfs::path& from)
+{
+	for ( auto& curPattern : patterns )
+	{
+		auto text = curPattern.find('/') == std::string::npos ? from.filename().string() : from.generic_string();
+		if ( DirWalker::MatchGlob(curPattern.c_str(), text.c_str()) )
+		{
+			return true;
+		}
+	}
+	return false;
+}
 
-						tmpIDG.add(curIDGItem.first + "." + curID.first, finalStr);
-					}
-					else if ( curID.first == "AdditionalLibraryDirectories" )
-					{
-						std::string finalStr;
-						for ( auto& curStr : projInfo.AdditionalLibraryDirectories )
-						{
-							finalStr += curStr + ";";
-						}
-						finalStr += "%(AdditionalLibraryDirectories)";
+//Resolves include once per project and plans its copy the first time it is seen.
+const SResolvedFile&	ResolveItem(const SProjectInfo& projInfo, ResolutionTable& table, FileMaterializer& materializer, const std::string& include)
+{
+	auto itor = table.find(include);
+	if ( itor == table.end() )
+	{
+		itor = table.emplace(include, ResolveFile(projInfo, include)).first;
+	}
 
-						tmpIDG.add(curIDGItem.first + "." + curID.first, finalStr);
-					}
-					else if ( curID.first == "ImportLibrary" )
-					{
-						tmpIDG.add(curIDGItem.first + "." + curID.first, R"($(SolutionDir)build\lib\$(ProjectName)\$(Configuration)\$(Platform)\$(PlatformToolset)\$(TargetName).lib)");
-					}
-					else if ( curID.first != "AssemblerListingLocation" && curID.first != "ProgramDataBaseFile" )
-					{
-						tmpIDG.add_child(curIDGItem.first + "." + curID.first, curID.second);
-					}
-				}
+	//The table may already hold it from the PruneIncludes pass.
+	if ( !itor->second.Planned_ && !itor->second.Pruned_ )
+	{
+		materializer.Add(itor->second.From_, itor->second.CopyPath_, itor->second.Mode_);
+		itor->second.Planned_ = true;
+	}
 
-				if ( curIDGItem.first == "ClCompile" )
-				{
-					tmpIDG.put(curIDGItem.first + ".ProgramDataBaseFileName", R"($(IntDir)vc$(PlatformToolsetVersion)$(TargetName).pdb)");
-				}
-			}
+	return itor->second;
+}
 
-			outputProjXml.add_child("Project.ItemDefinitionGroup", tmpIDG);
-		}
-		else if ( curProjItem.first == "ItemGroup" )
+ptree	ConvertPropertyGroup(const ptree& propertyGroup)
+{
+	auto outDir = propertyGroup.get_optional<std::string>("OutDir");
+	if ( !outDir )
+	{
+		return propertyGroup;
+	}
+
+	ptree tmpPG;
+	for ( auto& curPropertyGroupItem : propertyGroup )
+	{
+		if ( curPropertyGroupItem.first == "OutDir" )
 		{
-			ptree tmpIG;
+			auto dir = curPropertyGroupItem.second.get_value<std::string>();
+			ptree outDir;
+			outDir.add_child("<xmlattr>", curPropertyGroupItem.second.get_child("<xmlattr>"));
+			outDir.put_value(R"($(SolutionDir)build\bin\$(Configuration)\$(Platform)\$(PlatformToolset)\)");
 
-			for ( auto& curItemGroup : curProjItem.second )
-			{
-				if ( curItemGroup.first == "CustomBuild" )
-				{
-					if ( projInfo.IgnoreAllCustomBuild )
-					{
-						continue;
-					}
+			tmpPG.add_child(curPropertyGroupItem.first, outDir);
+		}
+		else if ( curPropertyGroupItem.first == "IntDir" )
+		{
+			auto dir = curPropertyGroupItem.second.get_value<std::string>();
+			ptree intDir;
+			intDir.add_child("<xmlattr>", curPropertyGroupItem.second.get_child("<xmlattr>"));
+			intDir.put_value(R"($(SolutionDir)build\obj\$(ProjectName)\$(Configuration)\$(Platform)\$(PlatformToolset)\)");
 
-					auto customFile = curItemGroup.second.get<std::string>("<xmlattr>.Include");
-					if ( projInfo.IgnoreCustomBuild.find(customFile) != projInfo.IgnoreCustomBuild.end() )
-					{
-						continue;
-					}
-				}
+			tmpPG.add_child(curPropertyGroupItem.first, intDir);
+		}
+		else if ( curPropertyGroupItem.first != "TargetName" )
+		{
+			tmpPG.add_child(curPropertyGroupItem.first, curPropertyGroupItem.second);
+		}
+	}
 
-				if ( curItemGroup.first == "ProjectReference" )
-				{
-					continue;
-				}
+	return tmpPG;
+}
 
-				if ( curItemGroup.first == "ClInclude" )//TODO:Hļ
-				{
-					ptree tmpFile;
+//Project-level lists written into every ItemDefinitionGroup. They are joined once per project
+//instead of once per configuration.
+class	SItemDefinitionLists
+{
+public:
+	explicit	SItemDefinitionLists(const SProjectInfo& projInfo)
+	{
+		AdditionalIncludeDirectories_ = JoinList(projInfo.AdditionalIncludeDirectories, "%(AdditionalIncludeDirectories)");
+		AdditionalDependencies_ = JoinList(projInfo.AdditionalDependencies, "%(AdditionalDependencies)");
+		AdditionalLibraryDirectories_ = JoinList(projInfo.AdditionalLibraryDirectories, "%(AdditionalLibraryDirectories)");
+	}
 
-					auto hFile = curItemGroup.second.get<std::string>("<xmlattr>.Include");
+	std::string	AdditionalIncludeDirectories_;
+	std::string	AdditionalDependencies_;
+	std::string	AdditionalLibraryDirectories_;
 
-					bfs::path filePath = hFile;
-					if ( !filePath.is_absolute() )
-					{
-						filePath = bfs::system_complete(projInfo.VCXProjectPath.From_ / hFile);
-					}
+private:
 
-					auto found = false;
-					for ( auto& curDir : projInfo.SrcList )
-					{
-						auto curRelPath = RelativeTo(curDir.From_, filePath);
-						if ( *curRelPath.begin() == ".." )
-						{
-							continue;
-						}
+	static	std::string	JoinList(const std::vector<std::string>& items, const std::string& inherited)
+	{
+		SemicolonList list;
+		for ( auto& curStr : items )
+		{
+			list.Append(curStr);
+		}
+		list.Add(inherited);
 
-						auto cpyPath = curDir.To_ / curRelPath;
-						bfs::create_directories(cpyPath.parent_path());
-						bfs::copy_file(filePath, cpyPath, bfs::copy_option::overwrite_if_exists);
+		return list.Join();
+	}
+};
 
-						auto relFromProj = RelativeTo(projInfo.VCXProjectPath.To_, cpyPath);
-						tmpFile.add("<xmlattr>.Include", relFromProj.string());
+//PrecompiledHeader: the header PlanPch generated and the sources compiled without it.
+class	SPchPlan
+{
+public:
+	bool		Enabled_ = false;
+	bfs::path	HeaderPath_;
+	bfs::path	SourcePath_;	//Compiled with PrecompiledHeader=Create.
+	std::string	HeaderName_;	//As PrecompiledHeaderFile and ForcedIncludeFiles name it.
+	std::string	HeaderText_;
+	size_t		HeaderCount_ = 0;
+	std::vector<std::pair<std::string, std::string>>	OriginalForced_;	//Condition of each ClCompile ItemDefinitionGroup -> its ForcedIncludeFiles before the header was added.
+	std::unordered_set<std::string>	OptOut_;	//Include of every ClCompile item compiled without it.
+};
 
-						found = true;
-						break;
-					}
-					
-					if ( !found )
-					{
-						auto cpyPath = projInfo.VCXProjectPath.To_ / "../Other/";
-						bfs::create_directories(cpyPath);
+ptree	ConvertItemDefinitionGroup(const SItemDefinitionLists& lists, const SPchPlan& pch, const ptree& itemDefinitionGroup)
+{
+	ptree tmpIDG;
+	//tmpIDG.add_child("<xmlattr>", itemDefinitionGroup.get_child("<xmlattr>"));
 
-						auto writePath = "../Other/" + filePath.filename().string();
-						tmpFile.add("<xmlattr>.Include", writePath);
-						bfs::copy_file(filePath, cpyPath / filePath.filename(), bfs::copy_option::overwrite_if_exists);
-					}
+	for ( auto& curIDGItem : itemDefinitionGroup )
+	{
+		//curIDGItem.first will be "ClCompile"/"ResourceCompile"/"Midl"/"Link"/"ProjectReference"
 
-					tmpIG.add_child(curItemGroup.first, tmpFile);
-				}
-				else if ( curItemGroup.first == "ClCompile" || curItemGroup.first == "ResourceCompile" )//TODO:CPPļ
-				{
-					ptree tmpFile;
+		auto usePch = pch.Enabled_ && curIDGItem.first == "ClCompile";
+		SemicolonList forcedIncludes;
+		forcedIncludes.Add(pch.HeaderName_);
 
-					for ( auto& cppItem : curItemGroup.second )
-					{
-						if ( cppItem.first == "<xmlattr>" )
-						{
-							auto cppFile = curItemGroup.second.get<std::string>("<xmlattr>.Include");
-							
-							bfs::path filePath = cppFile;
-							if ( !filePath.is_absolute() )
-							{
-								filePath = bfs::system_complete(projInfo.VCXProjectPath.From_ / cppFile);
-							}
+		for ( auto& curID : curIDGItem.second )
+		{
+			if ( usePch && (curID.first == "PrecompiledHeader" || curID.first == "PrecompiledHeaderFile") )
+			{
+				continue;
+			}
+			else if ( usePch && curID.first == "ForcedIncludeFiles" )
+			{
+				forcedIncludes.Append(curID.second.get_value<std::string>());
+			}
+			else if ( curID.first == "AdditionalIncludeDirectories" )
+			{
+				tmpIDG.add(curIDGItem.first + "." + curID.first, lists.AdditionalIncludeDirectories_);
+			}
+			else if ( curID.first == "PreprocessorDefinitions" )
+			{
+				//Empty and repeated definitions are dropped.
+				SemicolonList predefs(curID.second.get_value<std::string>());
 
-							auto found = false;
-							for ( auto& curDir : projInfo.SrcList )
-							{
-								auto curRelPath = RelativeTo(curDir.From_, filePath);
-								if ( *curRelPath.begin() == ".." )
-								{
-									continue;
-								}
+				tmpIDG.add(curIDGItem.first + "." + curID.first, predefs.Join());
+			}
+			else if ( curID.first == "AdditionalDependencies" )
+			{
+				tmpIDG.add(curIDGItem.first + "." + curID.first, lists.AdditionalDependencies_);
+			}
+			else if ( curID.first == "AdditionalLibraryDirectories" )
+			{
+				tmpIDG.add(curIDGItem.first + "." + curID.first, lists.AdditionalLibraryDirectories_);
+			}
+			else if ( curID.first == "ImportLibrary" )
+			{
+				tmpIDG.add(curIDGItem.first + "." + curID.first, R"($(SolutionDir)build\lib\$(ProjectName)\$(Configuration)\$(Platform)\$(PlatformToolset)\$(TargetName).lib)");
+			}
+			else if ( curID.first != "AssemblerListingLocation" && curID.first != "ProgramDataBaseFile" )
+			{
+				tmpIDG.add_child(curIDGItem.first + "." + curID.first, curID.second);
+			}
+		}
 
-								auto cpyPath = curDir.To_ / curRelPath;
-								bfs::create_directories( cpyPath.parent_path() );
-								bfs::copy_file(filePath, cpyPath, bfs::copy_option::overwrite_if_exists);
+		if ( curIDGItem.first == "ClCompile" )
+		{
+			tmpIDG.put(curIDGItem.first + ".ProgramDataBaseFileName", R"($(IntDir)vc$(PlatformToolsetVersion)$(TargetName).pdb)");
+		}
 
-								auto relFromProj = RelativeTo(projInfo.VCXProjectPath.To_, cpyPath);
-								tmpFile.add("<xmlattr>.Include", relFromProj.string());
+		//Forced in front of every source, so none of them has to be edited to use it.
+		if ( usePch )
+		{
+			forcedIncludes.Add("%(ForcedIncludeFiles)");
 
-								found = true;
-								break;
-							}
+			tmpIDG.put(curIDGItem.first + ".PrecompiledHeader", "Use");
+			tmpIDG.put(curIDGItem.first + ".PrecompiledHeaderFile", pch.HeaderName_);
+			tmpIDG.put(curIDGItem.first + ".ForcedIncludeFiles", forcedIncludes.Join());
+		}
+	}
 
-							if ( !found )
-							{
-								auto cpyPath = projInfo.VCXProjectPath.To_ / "../Other/";
-								bfs::create_directories(cpyPath);
+	return tmpIDG;
+}
 
-								auto writePath = "../Other/" + filePath.filename().string();
-								tmpFile.add("<xmlattr>.Include", writePath);
-								bfs::copy_file(filePath, cpyPath / filePath.filename(), bfs::copy_option::overwrite_if_exists);
-							}
-						}
-						else
-						{
-							tmpFile.add_child(cppItem.first, cppItem.second);
-						}
-					}
+//Converts one child of a project <ItemGroup>. Returns false when the item is dropped.
+bool	ConvertProjectItem(const SProjectInfo& projInfo, ResolutionTable& table, FileMaterializer& materializer, UnityBuild* unity, const SPchPlan& pch, const std::string& itemName, const ptree& curItem, ptree& tmpFile)
+{
+	if ( itemName == "CustomBuild" )
+	{
+		if ( projInfo.IgnoreAllCustomBuild )
+		{
+			return false;
+		}
+
+		auto customFile = curItem.get<std::string>("<xmlattr>.Include");
+		if ( projInfo.IgnoreCustomBuild.find(customFile) != projInfo.IgnoreCustomBuild.end() )
+		{
+			return false;
+		}
+	}
+
+	if ( itemName == "ProjectReference" )
+	{
+		return false;
+	}
+
+	if ( itemName == "ClInclude" )//TODO:Hļ
+	{
+		auto hFile = curItem.get<std::string>("<xmlattr>.Include");
+
+		auto& resolved = ResolveItem(projInfo, table, materializer, hFile);
+		if ( resolved.Pruned_ )
+		{
+			return false;
+		}
+		tmpFile.add("<xmlattr>.Include", resolved.Include_);
+	}
+	else if ( itemName == "ClCompile" || itemName == "ResourceCompile" )//TODO:CPPļ
+	{
+		const SResolvedFile* resolved = nullptr;
+		for ( auto& cppItem : curItem )
+		{
+			if ( cppItem.first == "<xmlattr>" )
+			{
+				auto cppFile = curItem.get<std::string>("<xmlattr>.Include");
+
+				resolved = &ResolveItem(projInfo, table, materializer, cppFile);
+				tmpFile.add("<xmlattr>.Include", resolved->Include_);
+			}
+			else
+			{
+				tmpFile.add_child(cppItem.first, cppItem.second);
+			}
+		}
 
-					tmpIG.add_child(curItemGroup.first, tmpFile);
+		//C sources, excluded and conflicting ones are compiled without the precompiled header.
+		auto noPch = pch.Enabled_ && itemName == "ClCompile" && pch.OptOut_.count(curItem.get<std::string>("<xmlattr>.Include")) > 0;
+		if ( noPch )
+		{
+			tmpFile.add("PrecompiledHeader", "NotUsing");
+			if ( !curItem.get_child_optional("ForcedIncludeFiles") )
+			{
+				//One value when the configurations agree, else one per configuration.
+				auto agree = std::all_of(pch.OriginalForced_.begin(), pch.OriginalForced_.end(),
+					[&](const std::pair<std::string, std::string>& forced) { return forced.second == pch.OriginalForced_.front().second; });
+				if ( agree )
+				{
+					tmpFile.add("ForcedIncludeFiles", pch.OriginalForced_.empty() ? std::string() : pch.OriginalForced_.front().second);
 				}
 				else
 				{
-					tmpIG.add_child(curItemGroup.first, curItemGroup.second);
+					for ( auto& curForced : pch.OriginalForced_ )
+					{
+						tmpFile.add("ForcedIncludeFiles", curForced.second).put("<xmlattr>.Condition", curForced.first);
+					}
 				}
 			}
-
-			outputProjXml.add_child("Project." + curProjItem.first, tmpIG);
 		}
-		else
+
+		//Sources with settings of their own are compiled on their own. A combined one stays in
+		//the project, excluded from the build, so it can still be opened and browsed.
+		auto combinable = unity && resolved && itemName == "ClCompile" && curItem.size() == 1 && !noPch && resolved->SrcDir_ != -1 &&
+			UnityBuild::IsSource(resolved->CopyPath_) && !MatchesAny(projInfo.UnityExclude, resolved->From_);
+		if ( combinable )
 		{
-			outputProjXml.add_child("Project." + curProjItem.first, curProjItem.second);
+			unity->Add(resolved->SrcDir_, resolved->CopyPath_);
+			tmpFile.add("ExcludedFromBuild", "true");
 		}
-
 	}
-	
+	else
 	{
-		bfs::create_directories(projInfo.VCXProjectPath.To_);
+		//Kept as it is; recorded so the filters keep the same Include.
+		auto include = curItem.get_optional<std::string>("<xmlattr>.Include");
+		if ( include && table.find(*include) == table.end() )
+		{
+			SResolvedFile unchanged;
+			unchanged.Include_ = *include;
+			table.emplace(*include, unchanged);
+		}
 
-		boost::filesystem::fstream ofs(projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj"), std::ios::trunc | std::ios::out);
-		auto settings = xml_writer_settings<std::string>();
-		settings.indent_count = 2;
-		//settings.indent_char = '\t';
-		write_xml(ofs, outputProjXml, settings);
+		tmpFile = curItem;
 	}
 
 	return true;
 }
 
-bool	BuildFilter(const SProjectInfo& projInfo)
+//What the PruneIncludes pass leaves out besides the ClInclude items it marks in the table.
+class	SPrunedFiles
 {
-	auto filterFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj.filters");
+public:
+	std::unordered_set<PathTable::ID>	Copies_;	//Destinations of AdditionalCopyList items.
+	size_t			Count_ = 0;
+	std::uintmax_t	Bytes_ = 0;
+};
+
+//PruneIncludes: follows #include from the compiled sources through the files the project
+//materializes and marks every header nothing reaches. Runs before the conversion; the items
+//it resolves go into the table, so each is still resolved once.
+bool	PruneIncludes(const SProjectInfo& projInfo, ResolutionTable& table, SPrunedFiles& pruned)
+{
+	auto& paths = PathTable::GetInstance();
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
 
-	ptree rawFilterXml, outputFilterXml;
+	IncludeScanner scanner;
+
+	//Headers that may be left out: ClInclude items by Include, copies by index.
+	std::vector<std::pair<std::string, PathTable::ID>> itemHeaders;
+	std::vector<std::pair<size_t, PathTable::ID>> copyHeaders;
 
 	try
 	{
-		boost::filesystem::fstream filterIfs(filterFileName);
-		boost::property_tree::read_xml(filterIfs, rawFilterXml, xml_parser::no_comments | xml_parser::trim_whitespace);
+		XmlDocument projXml;
+		projXml.Load(projFileName);
+
+		auto project = projXml.GetRoot().FirstChild_;
+		if ( !project || project->Name_ != "Project" )
+		{
+			std::cerr << "Can not find <Project>." << std::endl;
+			return false;
+		}
+
+		for ( auto curGroup = project->FirstChild_; curGroup; curGroup = curGroup->Next_ )
+		{
+			if ( curGroup->Name_ != "ItemGroup" )
+			{
+				continue;
+			}
+
+			for ( auto curItem = curGroup->FirstChild_; curItem; curItem = curItem->Next_ )
+			{
+				auto isSource = curItem->Name_ == "ClCompile" || curItem->Name_ == "ResourceCompile";
+				if ( !isSource && curItem->Name_ != "ClInclude" )
+				{
+					continue;
+				}
+
+				auto include = curItem->GetAttribute("Include");
+				if ( !include )
+				{
+					continue;
+				}
+
+				auto itor = table.find(*include);
+				if ( itor == table.end() )
+				{
+					itor = table.emplace(*include, ResolveFile(projInfo, *include)).first;
+				}
+
+				auto to = paths.Intern(itor->second.CopyPath_);
+				scanner.AddFile(to, itor->second.From_);
+				if ( isSource )
+				{
+					scanner.AddRoot(to);
+				}
+				else if ( IncludeScanner::IsHeader(itor->second.From_) )
+				{
+					itemHeaders.emplace_back(*include, to);
+				}
+				else
+				{
+					scanner.AddRoot(to);
+				}
+			}
+		}
 	}
 	catch ( std::exception& exp )
 	{
@@ -665,117 +983,998 @@ bool	BuildFilter(const SProjectInfo& projInfo)
 		return false;
 	}
 
-	auto projItems = rawFilterXml.get_child_optional("Project");
-	if ( !projItems )
+	for ( size_t index = 0; index < projInfo.AdditionalCopyList.size(); ++index )
 	{
-		std::cerr << "Can not find <Project>." << std::endl;
-		return false;
+		auto& curCpy = projInfo.AdditionalCopyList[index];
+		auto to = paths.Intern(curCpy.To_);
+		scanner.AddFile(to, curCpy.From_);
+		if ( IncludeScanner::IsHeader(curCpy.To_) )
+		{
+			copyHeaders.emplace_back(index, to);
+		}
+	}
+
+	//Directories are relative to the converted project; MSBuild macros can not be followed.
+	for ( auto& curDir : projInfo.AdditionalIncludeDirectories )
+	{
+		if ( curDir.find("$(") == std::string::npos )
+		{
+			scanner.AddIncludeDir(paths.Intern(projInfo.VCXProjectPath.ToID_, curDir));
+		}
+	}
+
+	for ( auto& curHeader : itemHeaders )
+	{
+		if ( MatchesAny(projInfo.PruneKeep, table[curHeader.first].From_) )
+		{
+			scanner.AddRoot(curHeader.second);
+		}
+	}
+	for ( auto& curHeader : copyHeaders )
+	{
+		if ( MatchesAny(projInfo.PruneKeep, projInfo.AdditionalCopyList[curHeader.first].From_) )
+		{
+			scanner.AddRoot(curHeader.second);
+		}
+	}
+
+	auto reachable = scanner.Scan(projInfo.CopyJobs);
+
+	//A header listed twice is counted once.
+	std::unordered_set<PathTable::ID> counted;
+	auto countPruned = [&](PathTable::ID to, const bfs::path& from)
+	{
+		if ( counted.insert(to).second )
+		{
+			boost::system::error_code ec;
+			auto size = bfs::file_size(from, ec);
+			++pruned.Count_;
+			pruned.Bytes_ += ec ? 0 : size;
+		}
+	};
+
+	for ( auto& curHeader : itemHeaders )
+	{
+		if ( reachable.count(curHeader.second) == 0 )
+		{
+			auto& resolved = table[curHeader.first];
+			resolved.Pruned_ = true;
+			countPruned(curHeader.second, resolved.From_);
+		}
+	}
+	for ( auto& curHeader : copyHeaders )
+	{
+		if ( reachable.count(curHeader.second) == 0 )
+		{
+			pruned.Copies_.insert(curHeader.second);
+			countPruned(curHeader.second, projInfo.AdditionalCopyList[curHeader.first].From_);
+		}
+	}
+
+	if ( projInfo.Report )
+	{
+		projInfo.Report->Add(ProjectReport::ECounter::FilesPruned, pruned.Count_);
+		projInfo.Report->Add(ProjectReport::ECounter::BytesPruned, pruned.Bytes_);
 	}
 
-	for ( auto& curProjItem : *projItems )
+	std::cout << projInfo.TargetName << ": " << reachable.size() << " files reachable through #include, " << pruned.Count_ << " headers left out (" << pruned.Bytes_ << " bytes)." << std::endl;
+	return true;
+}
+
+//PrecompiledHeader: counts the <> includes of the C++ sources and plans a header of the common
+//ones that are not files of the project. A project that already uses precompiled headers is
+//left alone. Like PruneIncludes it runs before the conversion and fills the table.
+bool	PlanPch(const SProjectInfo& projInfo, ResolutionTable& table, SPchPlan& pch)
+{
+	auto& paths = PathTable::GetInstance();
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+
+	PchPlanner planner(projInfo.PchMaxHeaders, projInfo.PchMinShare);
+	std::unordered_set<PathTable::ID> projectFiles;
+
+	try
 	{
-		if ( curProjItem.first == "ItemGroup" )
+		XmlDocument projXml;
+		projXml.Load(projFileName);
+
+		auto project = projXml.GetRoot().FirstChild_;
+		if ( !project || project->Name_ != "Project" )
 		{
-			ptree tmpIG;
+			std::cerr << "Can not find <Project>." << std::endl;
+			return false;
+		}
 
-			for ( auto& curItem : curProjItem.second )
+		for ( auto curGroup = project->FirstChild_; curGroup; curGroup = curGroup->Next_ )
+		{
+			if ( curGroup->Name_ == "ItemDefinitionGroup" )
 			{
-				if ( curItem.first == "Filter" )
+				auto clCompile = curGroup->GetChild("ClCompile");
+				if ( !clCompile )
 				{
-					tmpIG.add_child(curItem.first, curItem.second);
+					continue;
 				}
-				else
+
+				auto setting = clCompile->GetChild("PrecompiledHeader");
+				if ( setting && setting->Value_.Size_ > 0 && setting->Value_ != "NotUsing" )
 				{
-					if ( curItem.first == "CustomBuild" )
-					{
-						if ( projInfo.IgnoreAllCustomBuild )
-						{
-							continue;
-						}
+					std::cout << projInfo.TargetName << ": already uses precompiled headers, none generated." << std::endl;
+					return true;
+				}
 
-						auto customFile = curItem.second.get<std::string>("<xmlattr>.Include");
-						if ( projInfo.IgnoreCustomBuild.find(customFile) != projInfo.IgnoreCustomBuild.end() )
-						{
-							continue;
-						}
-					}
+				auto forced = clCompile->GetChild("ForcedIncludeFiles");
+				pch.OriginalForced_.emplace_back(curGroup->GetAttribute("Condition").get_value_or(std::string()), forced ? forced->Value_.str() : std::string());
+				continue;
+			}
 
-					ptree item; //Compile
+			if ( curGroup->Name_ != "ItemGroup" )
+			{
+				continue;
+			}
 
-					for ( auto& curItemProperty : curItem.second )
-					{
-						if ( curItemProperty.first == "<xmlattr>" )
-						{
-							bfs::path file = curItemProperty.second.get<std::string>("Include");
+			for ( auto curItem = curGroup->FirstChild_; curItem; curItem = curItem->Next_ )
+			{
+				if ( curItem->Name_ != "ClCompile" && curItem->Name_ != "ClInclude" )
+				{
+					continue;
+				}
 
-							auto filePath = file.is_absolute() ? file : bfs::system_complete(projInfo.VCXProjectPath.From_ / file);
-							auto parentPath = filePath.parent_path();
-							
-							auto found = false;
-							for ( auto& curDir : projInfo.SrcList )
-							{
-								auto tP = RelativeTo(curDir.From_, parentPath);
-								if ( !tP.empty() && *tP.begin() == ".." )
-								{
-									continue;
-								}
+				auto include = curItem->GetAttribute("Include");
+				if ( !include )
+				{
+					continue;
+				}
 
-								auto relPath = RelativeTo(projInfo.VCXProjectPath.To_, curDir.To_);
-								item.add("<xmlattr>.Include", (relPath / filePath.filename()).string());
+				auto itor = table.find(*include);
+				if ( itor == table.end() )
+				{
+					itor = table.emplace(*include, ResolveFile(projInfo, *include)).first;
+				}
 
-								found = true;
-								break;
-							}
+				auto& resolved = itor->second;
+				projectFiles.insert(paths.Intern(resolved.CopyPath_));
+				if ( curItem->Name_ != "ClCompile" )
+				{
+					continue;
+				}
 
-							assert(found);
-						}
-						else
-						{
-							item.add_child(curItemProperty.first, curItemProperty.second);
-						}
-					}
+				if ( curItem->GetChild("PrecompiledHeader") )
+				{
+					std::cout << projInfo.TargetName << ": already uses precompiled headers, none generated." << std::endl;
+					return true;
+				}
 
-					tmpIG.add_child(curItem.first, item);
+				auto isCpp = UnityBuild::IsSource(resolved.From_) && !boost::iequals(resolved.From_.extension().string(), ".c");
+				if ( !isCpp || MatchesAny(projInfo.PchExclude, resolved.From_) )
+				{
+					pch.OptOut_.insert(*include);
+				}
+				else
+				{
+					planner.AddSource(*include, resolved.From_);
 				}
 			}
-
-			outputFilterXml.add_child("Project." + curProjItem.first, tmpIG);
 		}
-		else
+	}
+	catch ( std::exception& exp )
+	{
+		std::cerr << exp.what() << std::endl;
+		return false;
+	}
+
+	for ( auto& curCpy : projInfo.AdditionalCopyList )
+	{
+		projectFiles.insert(paths.Intern(curCpy.To_));
+	}
+
+	//A header the include directories find among the project's own files is not stable.
+	std::vector<PathTable::ID> includeDirs;
+	for ( auto& curDir : projInfo.AdditionalIncludeDirectories )
+	{
+		if ( curDir.find("$(") == std::string::npos )
 		{
-			outputFilterXml.add_child("Project." + curProjItem.first, curProjItem.second);
+			includeDirs.push_back(paths.Intern(projInfo.VCXProjectPath.ToID_, curDir));
 		}
 	}
 
+	planner.Choose([&](const std::string& header)
 	{
-		bfs::create_directories(projInfo.VCXProjectPath.To_);
+		for ( auto curDir : includeDirs )
+		{
+			if ( projectFiles.count(paths.Intern(curDir, header)) > 0 )
+			{
+				return false;
+			}
+		}
+		return true;
+	});
 
-		boost::filesystem::fstream ofs(projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj.filters"), std::ios::trunc | std::ios::out);
-		auto settings = xml_writer_settings<std::string>();
-		settings.indent_count = 2;
+	if ( planner.GetHeaders().empty() )
+	{
+		std::cout << projInfo.TargetName << ": no header is common to enough sources, no precompiled header generated." << std::endl;
+		pch.OptOut_.clear();
+		return true;
+	}
 
-		write_xml(ofs, outputFilterXml, settings);
+	for ( auto& curConflict : planner.GetConflicts() )
+	{
+		pch.OptOut_.insert(curConflict);
 	}
 
+	auto dir = projInfo.VCXProjectPath.To_ / "Pch";
+	pch.Enabled_ = true;
+	pch.HeaderPath_ = dir / (projInfo.TargetName + "_pch.h");
+	pch.SourcePath_ = dir / (projInfo.TargetName + "_pch.cpp");
+	pch.HeaderName_ = paths.Relative(projInfo.VCXProjectPath.ToID_, paths.Intern(pch.HeaderPath_));
+	pch.HeaderText_ = planner.MakeHeaderText();
+	pch.HeaderCount_ = planner.GetHeaders().size();
+
+	std::cout << projInfo.TargetName << ": precompiled header of " << pch.HeaderCount_ << " headers, " << pch.OptOut_.size() << " sources compiled without it." << std::endl;
 	return true;
 }
 
-bool BuildProject(const SProjectInfo& projInfo)
+//Runs the PruneIncludes and PrecompiledHeader passes when the project asks for them, then
+//plans the AdditionalCopyFiles that were kept.
+bool	PlanProjectFiles(const SProjectInfo& projInfo, ResolutionTable& table, FileMaterializer& materializer, SPchPlan& pch)
 {
-	if ( !CheckConfig(projInfo) )
+	SPrunedFiles pruned;
+	if ( projInfo.PruneIncludes && !PruneIncludes(projInfo, table, pruned) )
+	{
+		return false;
+	}
+
+	if ( projInfo.AutoPch && !PlanPch(projInfo, table, pch) )
 	{
 		return false;
 	}
 
- 	if ( !BuildVCXPROJ(projInfo) )
- 	{
- 		return false;
- 	}
+	for ( auto& curCpy : projInfo.AdditionalCopyList )
+	{
+		if ( pruned.Copies_.empty() || pruned.Copies_.count(PathTable::GetInstance().Intern(curCpy.To_)) == 0 )
+		{
+			materializer.Add(curCpy.From_, curCpy.To_, curCpy.Mode_);
+		}
+	}
+
+	return true;
+}
+
+//Streams the source project through XmlReader/XmlWriter. Only one top-level element, or one
+//item of an <ItemGroup>, is held in memory at a time.
+bool	TransformVCXPROJ(const SProjectInfo& projInfo, std::istream& is, std::ostream& os, ResolutionTable& table, FileMaterializer& materializer, UnityBuild* unity, const SPchPlan& pch)
+{
+	XmlReader reader(is, (projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj")).string());
+	XmlWriter writer(os, 2);
 
-	if ( !BuildFilter(projInfo) )
+	if ( !reader.NextChild() || reader.GetName() != "Project" )
 	{
+		std::cerr << "Can not find <Project>." << std::endl;
 		return false;
 	}
 
+	auto& paths = PathTable::GetInstance();
+	SItemDefinitionLists lists(projInfo);
+	size_t unityWritten = 0;
+	auto pchWritten = false;
+
+	writer.WriteDeclaration();
+	writer.StartElement("Project", reader.GetAttributes());
+
+	while ( reader.NextChild() )
+	{
+		auto name = reader.GetName();
+
+		if ( name == "ItemGroup" )
+		{
+			writer.StartElement(name, reader.GetAttributes());
+
+			auto hasSources = false;
+			while ( reader.NextChild() )
+			{
+				auto itemName = reader.GetName();
+				hasSources = hasSources || itemName == "ClCompile";
+
+				ptree curItem, tmpFile;
+				reader.ReadElement(curItem);
+
+				if ( ConvertProjectItem(projInfo, table, materializer, unity, pch, itemName, curItem, tmpFile) )
+				{
+					writer.WriteElement(itemName, tmpFile);
+				}
+			}
+
+			//Unity sources follow the items they combine, in the same group.
+			if ( unity )
+			{
+				unity->Finish();
+
+				for ( ; unityWritten < unity->GetFiles().size(); ++unityWritten )
+				{
+					ptree unityItem;
+					unityItem.add("<xmlattr>.Include", paths.Relative(projInfo.VCXProjectPath.ToID_, paths.Intern(unity->GetFiles()[unityWritten].Path_)));
+					writer.WriteElement("ClCompile", unityItem);
+				}
+			}
+
+			//The source that creates the precompiled header goes with the first group of sources.
+			if ( pch.Enabled_ && hasSources && !pchWritten )
+			{
+				ptree pchItem;
+				pchItem.add("<xmlattr>.Include", paths.Relative(projInfo.VCXProjectPath.ToID_, paths.Intern(pch.SourcePath_)));
+				pchItem.add("PrecompiledHeader", "Create");
+				writer.WriteElement("ClCompile", pchItem);
+				pchWritten = true;
+			}
+
+			writer.EndElement();
+			continue;
+		}
+
+		ptree curProjItem;
+		reader.ReadElement(curProjItem);
+
+		if ( name == "PropertyGroup" )
+		{
+			writer.WriteElement(name, ConvertPropertyGroup(curProjItem));
+		}
+		else if ( name == "ItemDefinitionGroup" )
+		{
+			writer.WriteElement(name, ConvertItemDefinitionGroup(lists, pch, curProjItem));
+		}
+		else
+		{
+			writer.WriteElement(name, curProjItem);
+		}
+	}
+
+	writer.EndElement();
+	return true;
+}
+
+//UnityBuild: null when the project compiles every source on its own.
+std::unique_ptr<UnityBuild>	MakeUnityBuild(const SProjectInfo& projInfo)
+{
+	std::unique_ptr<UnityBuild> ret;
+	if ( projInfo.UnityBatchSize > 0 )
+	{
+		ret.reset(new UnityBuild(projInfo.VCXProjectPath.To_ / "Unity", projInfo.TargetName, projInfo.UnityBatchSize));
+	}
+	return ret;
+}
+
+//A source the conversion writes next to the project file.
+class	SGeneratedFile
+{
+public:
+	bfs::path	Path_;
+	std::string	Text_;
+	std::string	Kind_;	//Unity or Pch, for the dry-run plan.
+	std::string	Note_;
+};
+
+//Unity sources and the precompiled header, in the order they are written.
+std::vector<SGeneratedFile>	GetGeneratedFiles(const UnityBuild* unity, const SPchPlan& pch)
+{
+	std::vector<SGeneratedFile> ret;
+	if ( unity )
+	{
+		for ( auto& curFile : unity->GetFiles() )
+		{
+			SGeneratedFile file;
+			file.Path_ = curFile.Path_;
+			file.Text_ = curFile.Text_;
+			file.Kind_ = "Unity";
+			file.Note_ = std::to_string(static_cast<unsigned long long>(curFile.SourceCount_)) + " sources";
+			ret.push_back(file);
+		}
+	}
+
+	if ( pch.Enabled_ )
+	{
+		SGeneratedFile header;
+		header.Path_ = pch.HeaderPath_;
+		header.Text_ = pch.HeaderText_;
+		header.Kind_ = "Pch";
+		header.Note_ = std::to_string(static_cast<unsigned long long>(pch.HeaderCount_)) + " headers";
+		ret.push_back(header);
+
+		SGeneratedFile source;
+		source.Path_ = pch.SourcePath_;
+		source.Text_ = "//Generated by ProjConvertor. Do not edit.\n//Creates the precompiled header, which ForcedIncludeFiles brings in.\n";
+		source.Kind_ = "Pch";
+		source.Note_ = "creates it";
+		ret.push_back(source);
+	}
+
+	return ret;
+}
+
+//Destinations planned from two different sources. The first source is the one copied.
+void	PrintConflicts(const SProjectInfo& projInfo, const FileMaterializer& materializer)
+{
+	for ( auto& curConflict : materializer.GetConflicts() )
+	{
+		std::cerr << projInfo.TargetName << ": " << curConflict.To_ << " is claimed by " << curConflict.KeptFrom_ << " and " << curConflict.DroppedFrom_ << ", keeping the first." << std::endl;
+	}
+
+	if ( projInfo.Report )
+	{
+		projInfo.Report->Add(ProjectReport::ECounter::CopyConflicts, materializer.GetConflicts().size());
+	}
+}
+
+//--dry-run: converts the project into nothing and prints the copy plan with its byte totals.
+//Only reads the disk.
+bool	DryRunVCXPROJ(const SProjectInfo& projInfo, ResolutionTable& table)
+{
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+
+	FileMaterializer materializer(projInfo.CopyJobs);
+	SPchPlan pch;
+	if ( !PlanProjectFiles(projInfo, table, materializer, pch) )
+	{
+		return false;
+	}
+
+	auto unity = MakeUnityBuild(projInfo);
+	try
+	{
+		MappedIStream projIfs(projFileName);
+		std::ostream nullOs(nullptr);
+
+		if ( !TransformVCXPROJ(projInfo, projIfs, nullOs, table, materializer, unity.get(), pch) )
+		{
+			return false;
+		}
+	}
+	catch ( std::exception& exp )
+	{
+		std::cerr << exp.what() << std::endl;
+		return false;
+	}
+
+	materializer.Plan();
+	PrintConflicts(projInfo, materializer);
+
+	//Built first and printed at once, so plans of parallel projects do not interleave.
+	std::ostringstream oss;
+	std::uintmax_t totalBytes = 0;
+	size_t missingCount = 0;
+	for ( auto& curItem : materializer.GetPlan() )
+	{
+		boost::system::error_code ec;
+		auto size = bfs::file_size(curItem.From_, ec);
+
+		oss << "  " << std::left << std::setw(14) << FileMaterializer::GetModeName(curItem.Mode_) << curItem.From_.string() << " -> " << curItem.To_.string();
+		if ( ec )
+		{
+			oss << " (missing)";
+			++missingCount;
+		}
+		else
+		{
+			oss << " (" << size << " bytes)";
+			totalBytes += size;
+		}
+		oss << "\n";
+	}
+
+	for ( auto& curFile : GetGeneratedFiles(unity.get(), pch) )
+	{
+		oss << "  " << std::left << std::setw(14) << curFile.Kind_ << curFile.Path_.string() << " (" << curFile.Note_ << ")\n";
+	}
+
+	oss << projInfo.TargetName << ": " << materializer.GetPlan().size() << " files, " << totalBytes << " bytes planned, "
+		<< materializer.GetDuplicateCount() << " duplicates removed, " << materializer.GetConflicts().size() << " conflicts";
+	if ( missingCount > 0 )
+	{
+		oss << ", " << missingCount << " sources missing";
+	}
+	oss << "." << std::endl;
+
+	std::cout << projInfo.TargetName << ": copy plan\n" << oss.str();
+
+	return true;
+}
+
+//Adds a converted file to the archive with the bytes WriteIfChanged would have written.
+void	AddTextToArchive(TarWriter& archive, const bfs::path& to, const std::string& text, const bfs::path& from)
+{
+	archive.AddData(to, ToFileText(text), bfs::last_write_time(from));
+}
+
+//--archive: the converted project and every file it copies go into projInfo.Archive, named
+//as BuildVCXPROJ would write them. Nothing is written to the output directories.
+bool	ArchiveVCXPROJ(const SProjectInfo& projInfo, ResolutionTable& table)
+{
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+	auto outFileName = projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj");
+
+	FileMaterializer materializer(projInfo.CopyJobs);
+	materializer.SetReport(projInfo.Report);
+	materializer.SetSharedCache(projInfo.SharedCopies);
+	materializer.SetArchive(projInfo.Archive);
+	SPchPlan pch;
+	if ( !PlanProjectFiles(projInfo, table, materializer, pch) )
+	{
+		return false;
+	}
+
+	auto unity = MakeUnityBuild(projInfo);
+	std::ostringstream oss;
+	try
+	{
+		MappedIStream projIfs(projFileName);
+		if ( !TransformVCXPROJ(projInfo, projIfs, oss, table, materializer, unity.get(), pch) )
+		{
+			return false;
+		}
+
+		materializer.Run();
+		for ( auto& curFile : GetGeneratedFiles(unity.get(), pch) )
+		{
+			AddTextToArchive(*projInfo.Archive, curFile.Path_, curFile.Text_, projFileName);
+		}
+		AddTextToArchive(*projInfo.Archive, outFileName, oss.str(), projFileName);
+	}
+	catch ( std::exception& exp )
+	{
+		std::cerr << exp.what() << std::endl;
+		return false;
+	}
+
+	PrintConflicts(projInfo, materializer);
+
+	if ( projInfo.Report )
+	{
+		projInfo.Report->Add(ProjectReport::ECounter::FilesCopied, materializer.GetCopiedCount());
+		projInfo.Report->Add(ProjectReport::ECounter::FilesShared, materializer.GetSharedCount());
+		projInfo.Report->Add(ProjectReport::ECounter::BytesWritten, oss.str().size());
+	}
+
+	std::cout << projInfo.TargetName << ": " << materializer.GetCopiedCount() << " files archived";
+	if ( materializer.GetSharedCount() > 0 )
+	{
+		std::cout << ", " << materializer.GetSharedCount() << " shared with other projects";
+	}
+	std::cout << "." << std::endl;
+
+	return true;
+}
+
+bool	BuildVCXPROJ(const SProjectInfo& projInfo, ResolutionTable& table, ProjectFingerprint* fingerprint)
+{
+	if ( projInfo.DryRun )
+	{
+		return DryRunVCXPROJ(projInfo, table);
+	}
+
+	if ( projInfo.Archive )
+	{
+		return ArchiveVCXPROJ(projInfo, table);
+	}
+
+	auto projFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj");
+	auto outFileName = projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj");
+
+	{
+		PhaseTimer timer(projInfo.Report, ProjectReport::EPhase::CreateDirectories);
+		for ( auto& curSrcDir : projInfo.SrcList )
+		{
+			if ( bfs::exists(curSrcDir.To_) )
+			{
+				//bfs::remove_all(curSrcDir.To_);
+			}
+
+			bfs::create_directories(curSrcDir.To_);
+		}
+
+		if ( projInfo.Report )
+		{
+			projInfo.Report->Add(ProjectReport::ECounter::CreateDirectories, projInfo.SrcList.size());
+		}
+	}
+
+	FileMaterializer materializer(projInfo.CopyJobs);
+	materializer.SetReport(projInfo.Report);
+	materializer.SetUseIoUring(projInfo.UseIoUring);
+	materializer.SetSharedCache(projInfo.SharedCopies);
+	materializer.SetStore(projInfo.StorePath);
+	if ( projInfo.IncrementalCopy )
+	{
+		materializer.SetManifest(projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj.manifest"));
+	}
+
+	SPchPlan pch;
+	if ( !PlanProjectFiles(projInfo, table, materializer, pch) )
+	{
+		return false;
+	}
+
+	//The converted project is rendered in memory and written only after every copy has
+	//finished, and only when it differs from what is already there. So are unity sources and
+	//the precompiled header, which would otherwise recompile whole batches.
+	auto unity = MakeUnityBuild(projInfo);
+	std::string text;
+	auto changed = false;
+	try
+	{
+		std::ostringstream oss;
+		{
+			MappedIStream projIfs(projFileName);
+			if ( !TransformVCXPROJ(projInfo, projIfs, oss, table, materializer, unity.get(), pch) )
+			{
+				return false;
+			}
+		}
+
+		materializer.Run();
+
+		auto generated = GetGeneratedFiles(unity.get(), pch);
+		for ( auto& curFile : generated )
+		{
+			if ( !WriteIfChanged(curFile.Path_, ToFileText(curFile.Text_)) )
+			{
+				return false;
+			}
+		}
+
+		text = ToFileText(oss.str());
+		if ( !WriteIfChanged(outFileName, text, &changed) )
+		{
+			return false;
+		}
+
+		if ( fingerprint )
+		{
+			//Destinations another project writes change whenever that project runs.
+			std::set<bfs::path> foreign(materializer.GetForeignList().begin(), materializer.GetForeignList().end());
+			for ( auto& curItem : materializer.GetPlan() )
+			{
+				fingerprint->AddFile(curItem.From_);
+				if ( foreign.count(curItem.To_) == 0 )
+				{
+					fingerprint->AddFile(curItem.To_);
+				}
+			}
+			for ( auto& curFile : generated )
+			{
+				fingerprint->AddFile(curFile.Path_);
+			}
+			fingerprint->AddFile(outFileName);
+		}
+	}
+	catch ( std::exception& exp )
+	{
+		std::cerr << exp.what() << std::endl;
+		return false;
+	}
+
+	PrintConflicts(projInfo, materializer);
+
+	if ( projInfo.Report )
+	{
+		projInfo.Report->Add(ProjectReport::ECounter::FilesCopied, materializer.GetCopiedCount());
+		projInfo.Report->Add(ProjectReport::ECounter::FilesSkipped, materializer.GetSkippedCount());
+		projInfo.Report->Add(ProjectReport::ECounter::FilesShared, materializer.GetSharedCount());
+		projInfo.Report->Add(ProjectReport::ECounter::BytesWritten, changed ? text.size() : 0);
+	}
+
+	std::cout << projInfo.TargetName << ": " << materializer.GetCopiedCount() << " files copied, " << materializer.GetSkippedCount() << " skipped";
+	if ( materializer.GetSharedCount() > 0 )
+	{
+		std::cout << ", " << materializer.GetSharedCount() << " shared with other projects";
+	}
+	if ( materializer.GetFallbackCount() > 0 )
+	{
+		std::cout << ", " << materializer.GetFallbackCount() << " fell back to a plain copy";
+	}
+	if ( unity )
+	{
+		std::cout << ", " << unity->GetFiles().size() << " unity sources";
+	}
+	if ( !changed )
+	{
+		std::cout << ", project file unchanged";
+	}
+	std::cout << "." << std::endl;
+
+	return true;
+}
+
+//Converts one child of a filters <ItemGroup>. Returns false when the item is dropped. Includes
+//come from the table BuildVCXPROJ filled, so both files name the same path and no filesystem
+//call is made here.
+bool	ConvertFilterItem(const SProjectInfo& projInfo, const ResolutionTable& table, const std::string& itemName, const ptree& curItem, ptree& item)
+{
+	if ( itemName == "Filter" )
+	{
+		item = curItem;
+		return true;
+	}
+
+	if ( itemName == "CustomBuild" )
+	{
+		if ( projInfo.IgnoreAllCustomBuild )
+		{
+			return false;
+		}
+
+		auto customFile = curItem.get<std::string>("<xmlattr>.Include");
+		if ( projInfo.IgnoreCustomBuild.find(customFile) != projInfo.IgnoreCustomBuild.end() )
+		{
+			return false;
+		}
+	}
+
+	for ( auto& curItemProperty : curItem )
+	{
+		if ( curItemProperty.first == "<xmlattr>" )
+		{
+			auto file = curItemProperty.second.get<std::string>("Include");
+
+			auto itor = table.find(file);
+			if ( itor != table.end() && itor->second.Pruned_ )
+			{
+				return false;
+			}
+			if ( itor == table.end() )
+			{
+				std::cerr << projInfo.TargetName << ".vcxproj.filters: " << itemName << " " << file << " is not in " << projInfo.TargetName << ".vcxproj, dropped." << std::endl;
+				return false;
+			}
+
+			item.add("<xmlattr>.Include", itor->second.Include_);
+		}
+		else
+		{
+			item.add_child(curItemProperty.first, curItemProperty.second);
+		}
+	}
+
+	return true;
+}
+
+bool	TransformFilter(const SProjectInfo& projInfo, const ResolutionTable& table, std::istream& is, std::ostream& os)
+{
+	XmlReader reader(is, (projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj.filters")).string());
+	XmlWriter writer(os, 2);
+
+	if ( !reader.NextChild() || reader.GetName() != "Project" )
+	{
+		std::cerr << "Can not find <Project>." << std::endl;
+		return false;
+	}
+
+	writer.WriteDeclaration();
+	writer.StartElement("Project", reader.GetAttributes());
+
+	while ( reader.NextChild() )
+	{
+		auto name = reader.GetName();
+
+		if ( name == "ItemGroup" )
+		{
+			writer.StartElement(name, reader.GetAttributes());
+
+			while ( reader.NextChild() )
+			{
+				auto itemName = reader.GetName();
+
+				ptree curItem, item;
+				reader.ReadElement(curItem);
+
+				if ( ConvertFilterItem(projInfo, table, itemName, curItem, item) )
+				{
+					writer.WriteElement(itemName, item);
+				}
+			}
+
+			writer.EndElement();
+			continue;
+		}
+
+		ptree curProjItem;
+		reader.ReadElement(curProjItem);
+		writer.WriteElement(name, curProjItem);
+	}
+
+	writer.EndElement();
+	return true;
+}
+
+bool	BuildFilter(const SProjectInfo& projInfo, const ResolutionTable& table, ProjectFingerprint* fingerprint)
+{
+	auto filterFileName = projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj.filters");
+
+	if ( projInfo.DryRun )
+	{
+		//Still converted, into nothing, so items missing from the project are reported.
+		try
+		{
+			MappedIStream filterIfs(filterFileName);
+			std::ostream nullOs(nullptr);
+
+			return TransformFilter(projInfo, table, filterIfs, nullOs);
+		}
+		catch ( std::exception& exp )
+		{
+			std::cerr << exp.what() << std::endl;
+			return false;
+		}
+	}
+
+	auto outFileName = projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj.filters");
+
+	if ( projInfo.Archive )
+	{
+		try
+		{
+			MappedIStream filterIfs(filterFileName);
+			std::ostringstream oss;
+			if ( !TransformFilter(projInfo, table, filterIfs, oss) )
+			{
+				return false;
+			}
+
+			AddTextToArchive(*projInfo.Archive, outFileName, oss.str(), filterFileName);
+
+			if ( projInfo.Report )
+			{
+				projInfo.Report->Add(ProjectReport::ECounter::BytesWritten, oss.str().size());
+			}
+			return true;
+		}
+		catch ( std::exception& exp )
+		{
+			std::cerr << exp.what() << std::endl;
+			return false;
+		}
+	}
+
+	try
+	{
+		MappedIStream filterIfs(filterFileName);
+		std::ostringstream oss;
+		if ( !TransformFilter(projInfo, table, filterIfs, oss) )
+		{
+			return false;
+		}
+
+		auto text = ToFileText(oss.str());
+		auto changed = false;
+		if ( !WriteIfChanged(outFileName, text, &changed) )
+		{
+			return false;
+		}
+
+		if ( projInfo.Report && changed )
+		{
+			projInfo.Report->Add(ProjectReport::ECounter::BytesWritten, text.size());
+		}
+
+		if ( fingerprint )
+		{
+			fingerprint->AddFile(outFileName);
+		}
+	}
+	catch ( std::exception& exp )
+	{
+		std::cerr << exp.what() << std::endl;
+		return false;
+	}
+
+	return true;
+}
+
+bool BuildProject(const SProjectInfo& projInfo)
+{
+	ResolutionTable table;
+	return BuildProject(projInfo, table);
+}
+
+//Everything the conversion reads as a whole. Relative config paths were completed against the
+//working directory, so it is part of the inputs too.
+void	AddFingerprintInputs(const SProjectInfo& projInfo, ProjectFingerprint& fingerprint)
+{
+	fingerprint.AddInput(std::to_string(static_cast<unsigned long long>(projInfo.ConfigHash)));
+	fingerprint.AddInput(bfs::current_path().string());
+	fingerprint.AddInputFile(projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj"));
+	fingerprint.AddInputFile(projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj.filters"));
+
+	//Folder items are walked anew by every ReadConfig, so added and removed files show here.
+	for ( auto& curCpy : projInfo.AdditionalCopyList )
+	{
+		fingerprint.AddInput(curCpy.From_.string() + '\t' + curCpy.To_.string() + '\t' + FileMaterializer::GetModeName(curCpy.Mode_));
+	}
+}
+
+bfs::path	GetFingerprintFile(const SProjectInfo& projInfo)
+{
+	return projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj.fingerprint");
+}
+
+std::vector<std::string>	ReadProjectReferences(const SProjectInfo& projInfo)
+{
+	//A project that will be skipped as unchanged has its references in the fingerprint.
+	if ( projInfo.UseFingerprint && !projInfo.Rebuild )
+	{
+		ProjectFingerprint fingerprint;
+		AddFingerprintInputs(projInfo, fingerprint);
+
+		std::vector<std::string> ret;
+		if ( fingerprint.LoadReferences(GetFingerprintFile(projInfo), ret) )
+		{
+			return ret;
+		}
+	}
+
+	return ParseProjectReferences(projInfo);
+}
+
+bool BuildProject(const SProjectInfo& projInfo, ResolutionTable& table)
+{
+	table.clear();
+
+	{
+		PhaseTimer timer(projInfo.Report, ProjectReport::EPhase::CheckConfig);
+		if ( !CheckConfig(projInfo) )
+		{
+			return false;
+		}
+	}
+
+	//Nothing the last conversion depended on changed: neither XML file is parsed.
+	std::unique_ptr<ProjectFingerprint> fingerprint;
+	auto fingerprintFile = GetFingerprintFile(projInfo);
+	if ( projInfo.UseFingerprint )
+	{
+		fingerprint.reset(new ProjectFingerprint);
+		AddFingerprintInputs(projInfo, *fingerprint);
+		if ( !projInfo.Rebuild && fingerprint->Matches(fingerprintFile) )
+		{
+			if ( projInfo.Report )
+			{
+				projInfo.Report->Add(ProjectReport::ECounter::Unchanged);
+			}
+
+			std::cout << projInfo.TargetName << ": unchanged since the last conversion." << std::endl;
+			return true;
+		}
+
+		//A conversion that fails halfway must not leave the old one behind.
+		boost::system::error_code ec;
+		bfs::remove(fingerprintFile, ec);
+	}
+
+	{
+		PhaseTimer timer(projInfo.Report, ProjectReport::EPhase::BuildVCXPROJ);
+		if ( !BuildVCXPROJ(projInfo, table, fingerprint.get()) )
+		{
+			return false;
+		}
+	}
+
+	{
+		PhaseTimer timer(projInfo.Report, ProjectReport::EPhase::BuildFilter);
+		if ( !BuildFilter(projInfo, table, fingerprint.get()) )
+		{
+			return false;
+		}
+	}
+
+	if ( fingerprint )
+	{
+		try
+		{
+			fingerprint->SetReferences(ParseProjectReferences(projInfo));
+			fingerprint->Save(fingerprintFile);
+		}
+		catch ( std::exception& exp )
+		{
+			//Only costs the next run its shortcut.
+			std::cerr << exp.what() << std::endl;
+		}
+	}
+
 	return true;
 }
@@ -1,13 +1,21 @@
+#pragma once
+
 #include <boost/property_tree/ptree.hpp>
 
 #include <boost/filesystem.hpp>
 #include <boost/filesystem/fstream.hpp>
 #include <boost/filesystem/path.hpp>
 
+#include "FileMaterializer.h"
+#include "PathConverter.h"
+#include "PathTable.h"
+#include "ProjectFingerprint.h"
+#include "RunReport.h"
+#include "SrcDirIndex.h"
 
-#include <regex>
 #include <vector>
 #include <set>
+#include <unordered_map>
 
 using namespace boost::property_tree;
 namespace bfs = boost::filesystem;
@@ -21,25 +29,101 @@ public:
 	public:
 		bfs::path	From_;
 		bfs::path	To_;
+		PathTable::ID	FromID_ = PathTable::sEmpty;	//From_ and To_ interned.
+		PathTable::ID	ToID_ = PathTable::sEmpty;
 		bool		AddToIncludeDir_ = false;
+		FileMaterializer::EMode	Mode_ = FileMaterializer::EMode::Copy;
 	};
 
 	typedef	std::vector<std::string>	Vector;
 	typedef	std::vector<SSrcDir>		SrcDirList;
 
+	//An AdditionalCopyFiles <Folder>, kept so --watch can walk it again.
+	class	SCopyFolder
+	{
+	public:
+		bfs::path	From_;
+		bfs::path	To_;
+		Vector		Include_;
+		Vector		Exclude_;
+		FileMaterializer::EMode	Mode_ = FileMaterializer::EMode::Copy;
+	};
+
 	std::string	TargetName;
+	Vector		DependsOn;
 	bfs::path	ProjectBuildPath;
 	SSrcDir		VCXProjectPath;
 	SrcDirList	SrcList;
+	SrcDirIndex	SrcIndex;
+	MacroTable	Macros;
 	std::set<std::string>	IgnoreCustomBuild;
 	bool		IgnoreAllCustomBuild = false;
 	Vector		AdditionalCopyFiles;
+	FileMaterializer::CopyList	AdditionalCopyList;
+	std::vector<SCopyFolder>	AdditionalCopyFolders;
 	Vector		AdditionalIncludeDirectories;
 	Vector		AdditionalDependencies;
 	Vector		AdditionalLibraryDirectories;
+	unsigned	CopyJobs = 0;
+	bool		IncrementalCopy = false;
+	FileMaterializer::EMode	MaterializeMode = FileMaterializer::EMode::Copy;
+	bfs::path	StorePath;		//Content-addressed store for Mode="Store".
+	bool		UseIoUring = false;
+	ProjectReport*	Report = nullptr;	//Only set when a run report was asked for.
+	bool		DryRun = false;		//--dry-run: print the copy plan, write nothing.
+	SharedCopyCache*	SharedCopies = nullptr;	//Files already materialized by other projects of the run.
+	TarWriter*	Archive = nullptr;	//--archive: outputs go into this archive instead of the disk.
+	bool		PruneIncludes = false;	//Only headers reachable through #include are kept.
+	Vector		PruneKeep;		//Glob patterns of headers kept anyway.
+	size_t		UnityBatchSize = 0;	//UnityBuild: sources per generated unity source, 0 when off.
+	Vector		UnityExclude;	//Glob patterns of sources compiled on their own.
+	bool		AutoPch = false;	//PrecompiledHeader: generate one from the most included headers.
+	size_t		PchMaxHeaders = 16;
+	double		PchMinShare = 0.5;	//Share of the C++ sources a header must be included by.
+	Vector		PchExclude;		//Glob patterns of sources compiled without it.
+	std::uint64_t	ConfigHash = 0;	//Of the <Project> element, for the fingerprint.
+	bool		UseFingerprint = false;	//Skip the project when nothing it depends on changed.
+	bool		Rebuild = false;	//--rebuild: convert it anyway; the fingerprint is still saved.
 };
 
 typedef	std::vector<SProjectInfo>	ProjectList;
 
-ProjectList		ReadConfig();
-bool			BuildProject(const SProjectInfo& projInfo);
\ No newline at end of file
+//Where a project item ends up. CopyPath_ is empty for items that are kept as they are.
+class	SResolvedFile
+{
+public:
+	bfs::path	From_;
+	bfs::path	CopyPath_;
+	std::string	Include_;
+	FileMaterializer::EMode	Mode_ = FileMaterializer::EMode::Copy;
+	int			SrcDir_ = -1;		//Index into SrcList, -1 for ../Other.
+	bool		Planned_ = false;	//Handed to the materializer.
+	bool		Pruned_ = false;	//PruneIncludes: a header no compiled source reaches; dropped.
+};
+
+//Original Include of every item BuildVCXPROJ kept, to its resolution. BuildFilter only reads it.
+typedef	std::unordered_map<std::string, SResolvedFile>	ResolutionTable;
+
+bfs::path		RelativeTo(const bfs::path& from, const bfs::path& to);
+
+//text as a text-mode stream would write it: CRLF line ends on Windows.
+std::string		ToFileText(const std::string& text);
+
+//Replaces file with data through a temporary file and a rename, unless it already holds
+//exactly data: an unchanged output keeps its time stamp, so MSBuild and Visual Studio do not
+//reload it. changed tells which happened. Prints why and returns false when it can not write.
+bool			WriteIfChanged(const bfs::path& file, const std::string& data, bool* changed = nullptr);
+
+ProjectList		ReadConfig(const bfs::path& cfgFile = "config.xml");
+bool			BuildProject(const SProjectInfo& projInfo);
+bool			BuildProject(const SProjectInfo& projInfo, ResolutionTable& table);
+
+//The two halves of BuildProject, exposed for the benchmark. CheckConfig is not run.
+//fingerprint, when given, receives every file the conversion copied or wrote.
+bool			BuildVCXPROJ(const SProjectInfo& projInfo, ResolutionTable& table, ProjectFingerprint* fingerprint = nullptr);
+bool			BuildFilter(const SProjectInfo& projInfo, const ResolutionTable& table, ProjectFingerprint* fingerprint = nullptr);
+
+//Names of the projects referenced through <ProjectReference> in the source .vcxproj. Taken from
+//the project's fingerprint when it was saved from the same inputs, so an unchanged project is
+//not parsed for them.
+std::vector<std::string>	ReadProjectReferences(const SProjectInfo& projInfo);
\ No newline at end of file
@@ -0,0 +1,157 @@
+#include "ProjectFingerprint.h"
+#include "ContentStore.h"
+#include "FileTime.h"
+#include "MappedFile.h"
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/operations.hpp>
+
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
+namespace
+{
+	//Bumped whenever the conversion writes something different for the same inputs.
+	const	char*	sHeader = "ProjConvertor fingerprint 3";
+	const	char*	sReferences = "references";
+
+	std::string	ToHex(std::uint64_t value)
+	{
+		std::ostringstream oss;
+		oss << std::hex << std::setw(16) << std::setfill('0') << value;
+		return oss.str();
+	}
+}
+
+void ProjectFingerprint::AddInput(const std::string& text)
+{
+	//The length goes in too, so "ab" + "c" and "a" + "bc" differ.
+	auto size = static_cast<std::uint64_t>(text.size());
+	Inputs_ = ContentStore::Hash(&size, sizeof(size), Inputs_);
+	Inputs_ = ContentStore::Hash(text.data(), text.size(), Inputs_);
+}
+
+void ProjectFingerprint::AddInputFile(const bfs::path& file)
+{
+	MappedFile contents;
+	if ( !contents.Open(file) )
+	{
+		AddInput("missing " + file.string());
+		return;
+	}
+
+	AddInput(file.string());
+	Inputs_ = ContentStore::Hash(contents.GetData(), contents.GetSize(), Inputs_);
+}
+
+void ProjectFingerprint::AddFile(const bfs::path& file)
+{
+	SEntry entry;
+	entry.Path_ = file.string();
+
+	boost::system::error_code ec;
+	entry.Size_ = bfs::file_size(file, ec);
+	entry.WriteTime_ = ec ? 0 : GetWriteTimeNs(file, ec);
+	if ( ec )
+	{
+		//Never matches: the next run converts the project again.
+		entry.Size_ = static_cast<std::uintmax_t>(-1);
+	}
+
+	Files_.push_back(entry);
+}
+
+bool ProjectFingerprint::ReadHead(std::istream& is, std::vector<std::string>& references) const
+{
+	std::string line;
+	if ( !std::getline(is, line) || line != sHeader )
+	{
+		return false;
+	}
+
+	if ( !std::getline(is, line) || line != ToHex(Inputs_) )
+	{
+		return false;
+	}
+
+	//references \t name \t name ...
+	if ( !std::getline(is, line) || line.compare(0, std::strlen(sReferences), sReferences) != 0 )
+	{
+		return false;
+	}
+
+	references.clear();
+	std::istringstream iss(line.substr(std::strlen(sReferences)));
+	std::string name;
+	while ( std::getline(iss, name, '\t') )
+	{
+		if ( !name.empty() )
+		{
+			references.push_back(name);
+		}
+	}
+
+	return true;
+}
+
+bool ProjectFingerprint::LoadReferences(const bfs::path& file, std::vector<std::string>& references) const
+{
+	bfs::ifstream ifs(file);
+	return ReadHead(ifs, references);
+}
+
+bool ProjectFingerprint::Matches(const bfs::path& file) const
+{
+	bfs::ifstream ifs(file);
+	std::vector<std::string> references;
+	if ( !ReadHead(ifs, references) )
+	{
+		return false;
+	}
+
+	//size \t writeTime \t path
+	std::string line;
+	while ( std::getline(ifs, line) )
+	{
+		std::istringstream iss(line);
+		std::uintmax_t size = 0;
+		long long writeTime = 0;
+		std::string path;
+		if ( !(iss >> size >> writeTime) || !std::getline(iss.ignore(), path) )
+		{
+			return false;
+		}
+
+		boost::system::error_code ec;
+		if ( bfs::file_size(path, ec) != size || ec || GetWriteTimeNs(path, ec) != writeTime || ec )
+		{
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void ProjectFingerprint::Save(const bfs::path& file) const
+{
+	bfs::create_directories(file.parent_path());
+
+	bfs::ofstream ofs(file, std::ios::trunc | std::ios::out);
+	ofs << sHeader << '\n' << ToHex(Inputs_) << '\n' << sReferences;
+	for ( auto& curReference : References_ )
+	{
+		ofs << '\t' << curReference;
+	}
+	ofs << '\n';
+
+	for ( auto& curEntry : Files_ )
+	{
+		ofs << curEntry.Size_ << '\t' << static_cast<long long>(curEntry.WriteTime_) << '\t' << curEntry.Path_ << '\n';
+	}
+
+	if ( !ofs )
+	{
+		throw bfs::filesystem_error("Can not write the fingerprint", file, boost::system::errc::make_error_code(boost::system::errc::io_error));
+	}
+}
@@ -0,0 +1,59 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <istream>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//What a project's last successful conversion depended on: one hash of everything read as a
+//whole (its config element, .vcxproj, .filters and copy list) and the size and write time of
+//every file it copied from or wrote. Saved next to the converted project with the projects it
+//references; a rerun that finds all of it unchanged skips the project without parsing either
+//XML file.
+class	ProjectFingerprint
+{
+public:
+
+	//Mixes text into the input hash.
+	void		AddInput(const std::string& text);
+
+	//Mixes the contents of file into the input hash. A missing file hashes as missing.
+	void		AddInputFile(const bfs::path& file);
+
+	//Recorded with its size and write time as of now.
+	void		AddFile(const bfs::path& file);
+
+	//Names of the projects the .vcxproj references, saved with the fingerprint.
+	void		SetReferences(const std::vector<std::string>& references) { References_ = references; }
+
+	//The references saved in file, when it was saved from the same inputs. The files it lists are
+	//not checked: the references only depend on the .vcxproj, which is one of the inputs.
+	bool		LoadReferences(const bfs::path& file, std::vector<std::string>& references) const;
+
+	//True when file was saved from the same inputs and every file it lists is as recorded.
+	bool		Matches(const bfs::path& file) const;
+
+	//Throws bfs::filesystem_error when it can not write.
+	void		Save(const bfs::path& file) const;
+
+private:
+
+	//Reads the header, the input hash and the references; false unless they are ours.
+	bool		ReadHead(std::istream& is, std::vector<std::string>& references) const;
+
+	class	SEntry
+	{
+	public:
+		std::string		Path_;
+		std::uintmax_t	Size_ = 0;
+		std::int64_t	WriteTime_ = 0;	//Nanoseconds, see GetWriteTimeNs.
+	};
+
+	std::uint64_t	Inputs_ = 0;
+	std::vector<SEntry>	Files_;
+	std::vector<std::string>	References_;
+};
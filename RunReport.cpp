@@ -0,0 +1,181 @@
+#include "RunReport.h"
+
+#include <boost/filesystem/fstream.hpp>
+
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+
+namespace
+{
+	std::string	EscapeJson(const std::string& text)
+	{
+		std::string ret;
+		ret.reserve(text.size());
+		for ( auto ch : text )
+		{
+			switch ( ch )
+			{
+			case '"':	ret += "\\\""; break;
+			case '\\':	ret += "\\\\"; break;
+			case '\n':	ret += "\\n"; break;
+			case '\r':	ret += "\\r"; break;
+			case '\t':	ret += "\\t"; break;
+			default:
+				if ( static_cast<unsigned char>(ch) < 0x20 )
+				{
+					std::ostringstream oss;
+					oss << "\\u" << std::hex << std::setw(4) << std::setfill('0') << static_cast<int>(ch);
+					ret += oss.str();
+				}
+				else
+				{
+					ret += ch;
+				}
+				break;
+			}
+		}
+		return ret;
+	}
+}
+
+ProjectReport::ProjectReport(const std::string& name) : Name_(name)
+{
+	for ( auto& curTicks : PhaseTicks_ )
+	{
+		curTicks = 0;
+	}
+	for ( auto& curCounter : Counters_ )
+	{
+		curCounter = 0;
+	}
+}
+
+void ProjectReport::AddTime(EPhase phase, std::chrono::steady_clock::duration time)
+{
+	PhaseTicks_[static_cast<size_t>(phase)] += static_cast<std::int64_t>(time.count());
+}
+
+void ProjectReport::Add(ECounter counter, std::uint64_t value)
+{
+	Counters_[static_cast<size_t>(counter)] += value;
+}
+
+void ProjectReport::SetResult(const std::string& result, double seconds, const std::string& reason)
+{
+	Result_ = result;
+	Seconds_ = seconds;
+	Reason_ = reason;
+}
+
+double ProjectReport::GetSeconds(EPhase phase) const
+{
+	std::chrono::steady_clock::duration ticks(PhaseTicks_[static_cast<size_t>(phase)].load());
+	return std::chrono::duration<double>(ticks).count();
+}
+
+const char* ProjectReport::GetPhaseName(EPhase phase)
+{
+	switch ( phase )
+	{
+	case EPhase::CheckConfig:		return "CheckConfig";
+	case EPhase::ReadReferences:	return "ReadReferences";
+	case EPhase::BuildVCXPROJ:		return "BuildVCXPROJ";
+	case EPhase::ResolvePath:		return "ResolvePath";
+	case EPhase::CreateDirectories:	return "CreateDirectories";
+	case EPhase::Copy:				return "Copy";
+	case EPhase::BuildFilter:		return "BuildFilter";
+	default:						return "";
+	}
+}
+
+const char* ProjectReport::GetCounterName(ECounter counter)
+{
+	switch ( counter )
+	{
+	case ECounter::FilesCopied:			return "FilesCopied";
+	case ECounter::FilesSkipped:		return "FilesSkipped";
+	case ECounter::ResolvedToOther:		return "ResolvedToOther";
+	case ECounter::BytesWritten:		return "BytesWritten";
+	case ECounter::CreateDirectories:	return "CreateDirectories";
+	case ECounter::CopyConflicts:		return "CopyConflicts";
+	case ECounter::FilesShared:			return "FilesShared";
+	case ECounter::FilesPruned:			return "FilesPruned";
+	case ECounter::BytesPruned:			return "BytesPruned";
+	case ECounter::Unchanged:			return "Unchanged";
+	default:							return "";
+	}
+}
+
+ProjectReport* RunReport::AddProject(const std::string& name)
+{
+	Projects_.emplace_back(new ProjectReport(name));
+	return Projects_.back().get();
+}
+
+bool RunReport::Write(const boost::filesystem::path& reportPath) const
+{
+	boost::filesystem::ofstream ofs(reportPath, std::ios::trunc | std::ios::out);
+	if ( !ofs )
+	{
+		std::cerr << "Can not write " << reportPath << std::endl;
+		return false;
+	}
+
+	const auto phaseCount = static_cast<size_t>(ProjectReport::EPhase::Count);
+	const auto counterCount = static_cast<size_t>(ProjectReport::ECounter::Count);
+
+	std::uint64_t totals[counterCount] = {};
+
+	ofs << std::fixed << std::setprecision(6);
+	ofs << "{\n";
+	ofs << "  \"Jobs\": " << JobCount_ << ",\n";
+	ofs << "  \"ReadConfigSeconds\": " << ReadConfigSeconds_ << ",\n";
+	ofs << "  \"TotalSeconds\": " << TotalSeconds_ << ",\n";
+	ofs << "  \"Projects\": [";
+
+	for ( size_t projIndex = 0; projIndex < Projects_.size(); ++projIndex )
+	{
+		auto& curProj = *Projects_[projIndex];
+
+		ofs << (projIndex == 0 ? "\n" : ",\n");
+		ofs << "    {\n";
+		ofs << "      \"Name\": \"" << EscapeJson(curProj.Name_) << "\",\n";
+		ofs << "      \"Result\": \"" << EscapeJson(curProj.Result_.empty() ? "SKIPPED" : curProj.Result_) << "\",\n";
+		if ( !curProj.Reason_.empty() )
+		{
+			ofs << "      \"Reason\": \"" << EscapeJson(curProj.Reason_) << "\",\n";
+		}
+		ofs << "      \"Seconds\": " << curProj.Seconds_ << ",\n";
+
+		ofs << "      \"Phases\": {";
+		for ( size_t index = 0; index < phaseCount; ++index )
+		{
+			auto phase = static_cast<ProjectReport::EPhase>(index);
+			ofs << (index == 0 ? " " : ", ") << '"' << ProjectReport::GetPhaseName(phase) << "\": " << curProj.GetSeconds(phase);
+		}
+		ofs << " },\n";
+
+		ofs << "      \"Counters\": {";
+		for ( size_t index = 0; index < counterCount; ++index )
+		{
+			auto counter = static_cast<ProjectReport::ECounter>(index);
+			totals[index] += curProj.GetCount(counter);
+			ofs << (index == 0 ? " " : ", ") << '"' << ProjectReport::GetCounterName(counter) << "\": " << curProj.GetCount(counter);
+		}
+		ofs << " }\n";
+		ofs << "    }";
+	}
+
+	ofs << (Projects_.empty() ? "],\n" : "\n  ],\n");
+
+	ofs << "  \"Totals\": {";
+	for ( size_t index = 0; index < counterCount; ++index )
+	{
+		ofs << (index == 0 ? " " : ", ") << '"' << ProjectReport::GetCounterName(static_cast<ProjectReport::ECounter>(index)) << "\": " << totals[index];
+	}
+	ofs << " }\n";
+	ofs << "}\n";
+
+	return static_cast<bool>(ofs);
+}
@@ -0,0 +1,124 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+//Timing and I/O counters of one project. Instrumented code holds a ProjectReport pointer that
+//is null unless --report was given, so a normal run only pays for the null checks. Counters may
+//be updated from the copy workers.
+class	ProjectReport
+{
+public:
+
+	enum class	EPhase
+	{
+		CheckConfig,
+		ReadReferences,
+		BuildVCXPROJ,
+		ResolvePath,
+		CreateDirectories,
+		Copy,
+		BuildFilter,
+		Count,
+	};
+
+	enum class	ECounter
+	{
+		FilesCopied,
+		FilesSkipped,
+		ResolvedToOther,
+		BytesWritten,
+		CreateDirectories,
+		CopyConflicts,
+		FilesShared,
+		FilesPruned,
+		BytesPruned,
+		Unchanged,
+		Count,
+	};
+
+	explicit	ProjectReport(const std::string& name);
+
+	void		AddTime(EPhase phase, std::chrono::steady_clock::duration time);
+	void		Add(ECounter counter, std::uint64_t value = 1);
+
+	//Outcome from the scheduler's summary ("OK", "FAILED", "SKIPPED").
+	void		SetResult(const std::string& result, double seconds, const std::string& reason);
+
+	const std::string&	GetName() const { return Name_; }
+	double		GetSeconds(EPhase phase) const;
+	std::uint64_t	GetCount(ECounter counter) const { return Counters_[static_cast<size_t>(counter)]; }
+
+	static	const char*	GetPhaseName(EPhase phase);
+	static	const char*	GetCounterName(ECounter counter);
+
+private:
+
+	std::string	Name_;
+	std::atomic<std::int64_t>	PhaseTicks_[static_cast<size_t>(EPhase::Count)];
+	std::atomic<std::uint64_t>	Counters_[static_cast<size_t>(ECounter::Count)];
+	std::string	Result_;
+	double		Seconds_ = 0;
+	std::string	Reason_;
+
+	friend class	RunReport;
+};
+
+//Adds the time until it goes out of scope to a phase. Does nothing for a null report.
+class	PhaseTimer
+{
+public:
+
+	PhaseTimer(ProjectReport* report, ProjectReport::EPhase phase) : Report_(report), Phase_(phase)
+	{
+		if ( Report_ )
+		{
+			Start_ = std::chrono::steady_clock::now();
+		}
+	}
+
+	~PhaseTimer()
+	{
+		if ( Report_ )
+		{
+			Report_->AddTime(Phase_, std::chrono::steady_clock::now() - Start_);
+		}
+	}
+
+private:
+
+	PhaseTimer(const PhaseTimer&);
+	PhaseTimer&	operator=(const PhaseTimer&);
+
+	ProjectReport*	Report_;
+	ProjectReport::EPhase	Phase_;
+	std::chrono::steady_clock::time_point	Start_;
+};
+
+//Per-run report written by --report as JSON: run-level timings, every project's phases and
+//counters, and the counters summed over all projects.
+class	RunReport
+{
+public:
+
+	ProjectReport*	AddProject(const std::string& name);
+
+	void		SetReadConfigSeconds(double seconds) { ReadConfigSeconds_ = seconds; }
+	void		SetTotalSeconds(double seconds) { TotalSeconds_ = seconds; }
+	void		SetJobCount(unsigned jobCount) { JobCount_ = jobCount; }
+
+	bool		Write(const boost::filesystem::path& reportPath) const;
+
+private:
+
+	std::vector<std::unique_ptr<ProjectReport>>	Projects_;
+	double		ReadConfigSeconds_ = 0;
+	double		TotalSeconds_ = 0;
+	unsigned	JobCount_ = 0;
+};
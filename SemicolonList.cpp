@@ -0,0 +1,72 @@
+#include "SemicolonList.h"
+
+namespace
+{
+	bool	IsSpace(char ch)
+	{
+		return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+	}
+}
+
+void SemicolonList::Append(const std::string& text)
+{
+	size_t begin = 0;
+	while ( begin <= text.size() )
+	{
+		auto end = text.find(';', begin);
+		if ( end == std::string::npos )
+		{
+			end = text.size();
+		}
+
+		auto first = begin, last = end;
+		while ( first < last && IsSpace(text[first]) )
+		{
+			++first;
+		}
+		while ( last > first && IsSpace(text[last - 1]) )
+		{
+			--last;
+		}
+
+		if ( first < last )
+		{
+			Add(text.substr(first, last - first));
+		}
+
+		begin = end + 1;
+	}
+}
+
+bool SemicolonList::Add(const std::string& item)
+{
+	if ( item.empty() || !Seen_.insert(item).second )
+	{
+		return false;
+	}
+
+	Items_.push_back(item);
+	return true;
+}
+
+std::string SemicolonList::Join() const
+{
+	size_t size = 0;
+	for ( auto& curItem : Items_ )
+	{
+		size += curItem.size() + 1;
+	}
+
+	std::string ret;
+	ret.reserve(size);
+	for ( auto& curItem : Items_ )
+	{
+		if ( !ret.empty() )
+		{
+			ret += ';';
+		}
+		ret += curItem;
+	}
+
+	return ret;
+}
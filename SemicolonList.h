@@ -0,0 +1,29 @@
+#pragma once
+
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+//MSBuild semicolon list ("A;B;%(B)"). Items are split in one pass, trimmed, and kept in
+//their first-seen order; empty and repeated items are dropped.
+class	SemicolonList
+{
+public:
+
+	SemicolonList() {}
+	explicit	SemicolonList(const std::string& text) { Append(text); }
+
+	//Splits text and adds its items.
+	void		Append(const std::string& text);
+
+	//Adds a single item. Returns false when it is empty or already listed.
+	bool		Add(const std::string& item);
+
+	const std::vector<std::string>&	GetItems() const { return Items_; }
+	std::string	Join() const;
+
+private:
+
+	std::vector<std::string>	Items_;
+	std::unordered_set<std::string>	Seen_;
+};
@@ -0,0 +1,332 @@
+#include "SolutionFile.h"
+#include "PathTable.h"
+#include "XmlStream.h"
+
+#include <algorithm>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <set>
+
+namespace
+{
+	const char*	sCppProjectType = "{8BC9CEB8-8B4A-11D0-8D11-00A0C91BC942}";
+
+	bfs::path	OriginalFile(const SProjectInfo& projInfo)
+	{
+		return bfs::system_complete(projInfo.VCXProjectPath.From_ / (projInfo.TargetName + ".vcxproj"));
+	}
+
+	bfs::path	ConvertedFile(const SProjectInfo& projInfo)
+	{
+		return bfs::system_complete(projInfo.VCXProjectPath.To_ / (projInfo.TargetName + ".vcxproj"));
+	}
+
+	//Solutions name projects relative to themselves, with backslashes.
+	std::string	SolutionPath(const bfs::path& slnDir, const bfs::path& file)
+	{
+		auto ret = RelativeTo(slnDir, file).string();
+		std::replace(ret.begin(), ret.end(), '/', '\\');
+		return ret;
+	}
+
+	bfs::path	FromSolutionPath(const bfs::path& slnDir, std::string path)
+	{
+		std::replace(path.begin(), path.end(), '\\', '/');
+
+		bfs::path ret = path;
+		if ( !ret.is_absolute() )
+		{
+			ret = slnDir / ret;
+		}
+		return ret;
+	}
+
+	bool	ReadText(const bfs::path& file, std::string& text)
+	{
+		bfs::ifstream ifs(file, std::ios::in | std::ios::binary);
+		if ( !ifs )
+		{
+			std::cerr << "Can not read " << file << std::endl;
+			return false;
+		}
+
+		text.assign(std::istreambuf_iterator<char>(ifs), std::istreambuf_iterator<char>());
+		return true;
+	}
+
+	//Project("{Type}") = "Name", "Path", "{GUID}" split on its quotes: fields 1, 3, 5 and 7 are
+	//the type, name, path and GUID. Solution folders have their name as path.
+	bool	SplitProjectLine(const std::string& line, std::vector<std::string>& fields)
+	{
+		fields.clear();
+		if ( line.compare(0, 8, "Project(") != 0 )
+		{
+			return false;
+		}
+
+		size_t pos = 0;
+		for ( ;; )
+		{
+			auto quote = line.find('"', pos);
+			fields.push_back(line.substr(pos, quote == std::string::npos ? std::string::npos : quote - pos));
+			if ( quote == std::string::npos )
+			{
+				break;
+			}
+			pos = quote + 1;
+		}
+
+		auto ext = bfs::path(fields.size() > 5 ? fields[5] : std::string()).extension().string();
+		return fields.size() >= 9 && ext.size() > 4 && ext.compare(ext.size() - 4, 4, "proj") == 0;
+	}
+
+	std::string	JoinFields(const std::vector<std::string>& fields)
+	{
+		std::string ret;
+		for ( auto& curField : fields )
+		{
+			if ( &curField != &fields.front() )
+			{
+				ret += '"';
+			}
+			ret += curField;
+		}
+		return ret;
+	}
+
+	class	SSlnProject
+	{
+	public:
+		const SProjectInfo*	Info_ = nullptr;
+		std::string	GUID_;
+		std::vector<std::string>	Configs_;
+	};
+
+	//ProjectGUID and ProjectConfiguration Includes of a converted project.
+	bool	ReadSlnProject(SSlnProject& project)
+	{
+		auto projFile = ConvertedFile(*project.Info_);
+
+		try
+		{
+			XmlDocument projXml;
+			projXml.Load(projFile);
+
+			auto root = projXml.GetRoot().FirstChild_;
+			if ( !root || root->Name_ != "Project" )
+			{
+				std::cerr << "Can not read " << projFile << std::endl;
+				return false;
+			}
+
+			for ( auto curGroup = root->FirstChild_; curGroup; curGroup = curGroup->Next_ )
+			{
+				for ( auto curItem = curGroup->FirstChild_; curItem; curItem = curItem->Next_ )
+				{
+					if ( curGroup->Name_ == "ItemGroup" && curItem->Name_ == "ProjectConfiguration" )
+					{
+						project.Configs_.push_back(curItem->GetAttribute("Include").get_value_or(std::string()));
+					}
+					else if ( curGroup->Name_ == "PropertyGroup" && (curItem->Name_ == "ProjectGUID" || curItem->Name_ == "ProjectGuid") )
+					{
+						project.GUID_ = curItem->Value_.str();
+					}
+				}
+			}
+		}
+		catch ( std::exception& exp )
+		{
+			std::cerr << exp.what() << std::endl;
+			return false;
+		}
+
+		if ( project.GUID_.empty() )
+		{
+			std::cerr << "No ProjectGUID in " << projFile << std::endl;
+			return false;
+		}
+
+		return true;
+	}
+}
+
+bool RewriteSolution(const bfs::path& inFile, const bfs::path& outFile, const ProjectList& projList)
+{
+	std::string text;
+	if ( !ReadText(inFile, text) )
+	{
+		return false;
+	}
+
+	auto inDir = bfs::system_complete(inFile).parent_path();
+	auto outDir = bfs::system_complete(outFile).parent_path();
+
+	auto& paths = PathTable::GetInstance();
+
+	std::map<PathTable::ID, const SProjectInfo*> converted;
+	for ( auto& curProj : projList )
+	{
+		converted[paths.Intern(OriginalFile(curProj))] = &curProj;
+	}
+
+	std::string out;
+	out.reserve(text.size());
+
+	std::vector<std::string> fields;
+	for ( size_t pos = 0; pos < text.size(); )
+	{
+		auto end = text.find('\n', pos);
+		end = end == std::string::npos ? text.size() : end + 1;
+
+		auto line = text.substr(pos, end - pos);
+		pos = end;
+
+		if ( SplitProjectLine(line, fields) )
+		{
+			auto original = FromSolutionPath(inDir, fields[5]);
+			auto itor = converted.find(paths.Intern(original));
+			if ( itor != converted.end() )
+			{
+				fields[5] = SolutionPath(outDir, ConvertedFile(*itor->second));
+			}
+			else
+			{
+				std::cout << fields[3] << " is not converted, the solution keeps " << original << std::endl;
+				fields[5] = SolutionPath(outDir, original);
+			}
+			line = JoinFields(fields);
+		}
+
+		out += line;
+	}
+
+	return WriteIfChanged(outFile, out);
+}
+
+bool WriteSolution(const bfs::path& outFile, const ProjectList& projList)
+{
+	std::vector<SSlnProject> projects(projList.size());
+	std::map<std::string, const SSlnProject*> byName;
+	for ( size_t index = 0; index < projList.size(); ++index )
+	{
+		projects[index].Info_ = &projList[index];
+		if ( !ReadSlnProject(projects[index]) )
+		{
+			return false;
+		}
+		byName[projList[index].TargetName] = &projects[index];
+	}
+
+	//Solution configurations in the order the projects list them.
+	std::vector<std::string> configs;
+	std::set<std::string> seenConfigs;
+	for ( auto& curProj : projects )
+	{
+		for ( auto& curConfig : curProj.Configs_ )
+		{
+			if ( seenConfigs.insert(curConfig).second )
+			{
+				configs.push_back(curConfig);
+			}
+		}
+	}
+
+	auto outDir = bfs::system_complete(outFile).parent_path();
+
+	std::string out = "\xEF\xBB\xBF\r\nMicrosoft Visual Studio Solution File, Format Version 12.00\r\n# Visual Studio 2013\r\n";
+	for ( auto& curProj : projects )
+	{
+		auto& info = *curProj.Info_;
+		out += "Project(\"" + std::string(sCppProjectType) + "\") = \"" + info.TargetName + "\", \"" + SolutionPath(outDir, ConvertedFile(info)) + "\", \"" + curProj.GUID_ + "\"\r\n";
+
+		//Other converted projects this one depends on; anything else is outside the solution.
+		auto depends = info.DependsOn;
+		for ( auto& curRef : ReadProjectReferences(info) )
+		{
+			depends.push_back(curRef);
+		}
+
+		std::set<std::string> dependGUIDs;
+		for ( auto& curDepend : depends )
+		{
+			auto itor = byName.find(curDepend);
+			if ( itor != byName.end() && itor->second != &curProj )
+			{
+				dependGUIDs.insert(itor->second->GUID_);
+			}
+		}
+
+		if ( !dependGUIDs.empty() )
+		{
+			out += "\tProjectSection(ProjectDependencies) = postProject\r\n";
+			for ( auto& curGUID : dependGUIDs )
+			{
+				out += "\t\t" + curGUID + " = " + curGUID + "\r\n";
+			}
+			out += "\tEndProjectSection\r\n";
+		}
+		out += "EndProject\r\n";
+	}
+
+	out += "Global\r\n\tGlobalSection(SolutionConfigurationPlatforms) = preSolution\r\n";
+	for ( auto& curConfig : configs )
+	{
+		out += "\t\t" + curConfig + " = " + curConfig + "\r\n";
+	}
+	out += "\tEndGlobalSection\r\n\tGlobalSection(ProjectConfigurationPlatforms) = postSolution\r\n";
+	for ( auto& curProj : projects )
+	{
+		for ( auto& curConfig : curProj.Configs_ )
+		{
+			out += "\t\t" + curProj.GUID_ + "." + curConfig + ".ActiveCfg = " + curConfig + "\r\n";
+			out += "\t\t" + curProj.GUID_ + "." + curConfig + ".Build.0 = " + curConfig + "\r\n";
+		}
+	}
+	out += "\tEndGlobalSection\r\n\tGlobalSection(SolutionProperties) = preSolution\r\n\t\tHideSolutionNode = FALSE\r\n\tEndGlobalSection\r\nEndGlobal\r\n";
+
+	return WriteIfChanged(outFile, out);
+}
+
+bool FilterBySolution(const bfs::path& slnFile, ProjectList& projList)
+{
+	std::string text;
+	if ( !ReadText(slnFile, text) )
+	{
+		return false;
+	}
+
+	auto slnDir = bfs::system_complete(slnFile).parent_path();
+
+	auto& paths = PathTable::GetInstance();
+
+	std::set<PathTable::ID> listed;
+	std::vector<std::string> fields;
+	for ( size_t pos = 0; pos < text.size(); )
+	{
+		auto end = text.find('\n', pos);
+		end = end == std::string::npos ? text.size() : end + 1;
+
+		if ( SplitProjectLine(text.substr(pos, end - pos), fields) )
+		{
+			listed.insert(paths.Intern(FromSolutionPath(slnDir, fields[5])));
+		}
+		pos = end;
+	}
+
+	ProjectList kept;
+	for ( auto& curProj : projList )
+	{
+		if ( listed.count(paths.Intern(OriginalFile(curProj))) > 0 )
+		{
+			kept.push_back(curProj);
+		}
+		else
+		{
+			std::cout << curProj.TargetName << " is not in " << slnFile << ", skipped." << std::endl;
+		}
+	}
+
+	projList.swap(kept);
+	return true;
+}
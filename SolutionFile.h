@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ProjConvertor.h"
+
+//Writes outFile from the solution inFile with every converted project pointing at its converted
+//.vcxproj. Projects of the solution that are not in projList (ALL_BUILD, ZERO_CHECK, ...) keep
+//pointing at their original file. Everything else, BOM and line endings included, is copied as it is.
+bool	RewriteSolution(const bfs::path& inFile, const bfs::path& outFile, const ProjectList& projList);
+
+//Writes a new solution holding the converted projects, with their DependsOn as build
+//dependencies. GUIDs and configurations are read from the converted .vcxproj files.
+bool	WriteSolution(const bfs::path& outFile, const ProjectList& projList);
+
+//Only the projects of projList whose .vcxproj is listed in slnFile are kept.
+bool	FilterBySolution(const bfs::path& slnFile, ProjectList& projList);
@@ -0,0 +1,26 @@
+#include "SrcDirIndex.h"
+
+void SrcDirIndex::Add(PathTable::ID root, int rootIndex)
+{
+	//The first item listed for a root wins, as it did with the linear scan.
+	Roots_.emplace(root, rootIndex);
+}
+
+int SrcDirIndex::Find(PathTable::ID file) const
+{
+	//The first root met walking up is the longest one.
+	auto& paths = PathTable::GetInstance();
+	for ( auto node = file;; node = paths.GetParent(node) )
+	{
+		auto itor = Roots_.find(node);
+		if ( itor != Roots_.end() )
+		{
+			return itor->second;
+		}
+
+		if ( node == PathTable::sEmpty )
+		{
+			return -1;
+		}
+	}
+}
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include "PathTable.h"
+
+#include <unordered_map>
+
+namespace bfs = boost::filesystem;
+
+//Index over the From_ roots of the SrcDirectories items. Roots are interned paths, so a file
+//is matched against every root by walking up its own parents once.
+class	SrcDirIndex
+{
+public:
+
+	void	Add(PathTable::ID root, int rootIndex);
+
+	//Returns the index of the longest root containing file, or -1 when no root contains it.
+	int		Find(PathTable::ID file) const;
+
+private:
+
+	std::unordered_map<PathTable::ID, int>	Roots_;
+};
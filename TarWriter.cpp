@@ -0,0 +1,311 @@
+#include "TarWriter.h"
+#include "MappedFile.h"
+#include "PathTable.h"
+
+#include <boost/filesystem.hpp>
+
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+
+#ifdef PROJCONV_ZLIB
+#include <zlib.h>
+#endif
+
+namespace
+{
+	const size_t	sBlockSize = 512;
+
+	//Octal, NUL terminated, as ustar wants. Sizes of 8 GB and more use the base-256 form GNU
+	//tar and libarchive read.
+	void	PutNumber(char* field, size_t width, std::uintmax_t value)
+	{
+		if ( value >> (3 * (width - 1)) )
+		{
+			std::memset(field, 0, width);
+			field[0] = static_cast<char>(0x80);
+			for ( auto index = width - 1; index > 0 && value; --index, value >>= 8 )
+			{
+				field[index] = static_cast<char>(value & 0xFF);
+			}
+			return;
+		}
+
+		field[width - 1] = '\0';
+		for ( auto index = width - 1; index-- > 0; value >>= 3 )
+		{
+			field[index] = static_cast<char>('0' + (value & 7));
+		}
+	}
+
+	//"<length> path=<name>\n", where length counts the whole record including itself.
+	std::string	PaxPathRecord(const std::string& name)
+	{
+		auto body = " path=" + name + "\n";
+		auto length = body.size();
+		while ( std::to_string(static_cast<unsigned long long>(length)).size() + body.size() != length )
+		{
+			length = std::to_string(static_cast<unsigned long long>(length)).size() + body.size();
+		}
+		return std::to_string(static_cast<unsigned long long>(length)) + body;
+	}
+}
+
+#ifdef PROJCONV_ZLIB
+
+class	TarWriter::SDeflate
+{
+public:
+
+	SDeflate()
+	{
+		std::memset(&Stream_, 0, sizeof(Stream_));
+
+		//windowBits + 16: gzip header and trailer instead of zlib's.
+		Ok_ = deflateInit2(&Stream_, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY) == Z_OK;
+	}
+
+	~SDeflate()
+	{
+		if ( Ok_ )
+		{
+			deflateEnd(&Stream_);
+		}
+	}
+
+	bool		IsOk() const { return Ok_; }
+
+	void		Compress(const char* data, size_t size, bool finish, std::ostream& os)
+	{
+		Stream_.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data));
+		Stream_.avail_in = static_cast<uInt>(size);
+
+		do
+		{
+			Stream_.next_out = reinterpret_cast<Bytef*>(Buffer_);
+			Stream_.avail_out = sizeof(Buffer_);
+			deflate(&Stream_, finish ? Z_FINISH : Z_NO_FLUSH);
+			os.write(Buffer_, sizeof(Buffer_) - Stream_.avail_out);
+		} while ( Stream_.avail_out == 0 );
+	}
+
+private:
+
+	z_stream	Stream_;
+	bool		Ok_;
+	char		Buffer_[64 * 1024];
+};
+
+#else
+
+class	TarWriter::SDeflate
+{
+public:
+	bool		IsOk() const { return false; }
+	void		Compress(const char*, size_t, bool, std::ostream&) {}
+};
+
+#endif
+
+TarWriter::TarWriter()
+{
+}
+
+TarWriter::~TarWriter()
+{
+}
+
+bool TarWriter::IsGzipAvailable()
+{
+#ifdef PROJCONV_ZLIB
+	return true;
+#else
+	return false;
+#endif
+}
+
+bool TarWriter::Open(const bfs::path& file, const bfs::path& root, bool gzip)
+{
+	if ( gzip && !IsGzipAvailable() )
+	{
+		std::cerr << "Can not write " << file << ": built without zlib (PROJCONV_ZLIB)." << std::endl;
+		return false;
+	}
+
+	File_ = file;
+	Root_ = bfs::absolute(root);
+
+	if ( file.has_parent_path() )
+	{
+		bfs::create_directories(file.parent_path());
+	}
+
+	Ofs_.open(file, std::ios::out | std::ios::trunc | std::ios::binary);
+	if ( !Ofs_ )
+	{
+		std::cerr << "Can not write " << file << std::endl;
+		return false;
+	}
+
+	if ( gzip )
+	{
+		Deflate_.reset(new SDeflate);
+		if ( !Deflate_->IsOk() )
+		{
+			std::cerr << "Can not start compressing " << file << std::endl;
+			return false;
+		}
+	}
+
+	return true;
+}
+
+void TarWriter::Write(const char* data, size_t size)
+{
+	if ( !Deflate_ )
+	{
+		Ofs_.write(data, static_cast<std::streamsize>(size));
+		return;
+	}
+
+	//zlib counts in 32 bits.
+	const size_t chunkSize = 1 << 30;
+	for ( size_t offset = 0; offset < size; offset += chunkSize )
+	{
+		Deflate_->Compress(data + offset, std::min(chunkSize, size - offset), false, Ofs_);
+	}
+}
+
+std::string TarWriter::GetEntryName(const bfs::path& to) const
+{
+	auto& paths = PathTable::GetInstance();
+
+	auto root = paths.Intern(Root_);
+	auto path = paths.Intern(bfs::absolute(to));
+	if ( path == root || !paths.IsWithin(path, root) )
+	{
+		throw bfs::filesystem_error("Outside the archive root", to, Root_, boost::system::errc::make_error_code(boost::system::errc::invalid_argument));
+	}
+
+	//Entry names always use '/'.
+	auto ret = paths.Relative(root, path);
+	std::replace(ret.begin(), ret.end(), '\\', '/');
+	return ret;
+}
+
+void TarWriter::WriteHeader(const std::string& name, std::uintmax_t size, std::time_t writeTime, char type)
+{
+	char header[sBlockSize] = {};
+
+	//Names longer than 100 bytes are split into prefix and name at a '/' when they fit.
+	auto split = std::string::npos;
+	if ( name.size() > 100 )
+	{
+		split = name.rfind('/', 155);
+		if ( split != std::string::npos && name.size() - split - 1 > 100 )
+		{
+			split = std::string::npos;
+		}
+	}
+
+	if ( split != std::string::npos )
+	{
+		std::memcpy(header + 345, name.data(), split);
+		std::memcpy(header, name.data() + split + 1, name.size() - split - 1);
+	}
+	else
+	{
+		std::memcpy(header, name.data(), std::min<size_t>(name.size(), 100));
+	}
+
+	PutNumber(header + 100, 8, 0644);
+	PutNumber(header + 108, 8, 0);
+	PutNumber(header + 116, 8, 0);
+	PutNumber(header + 124, 12, size);
+	PutNumber(header + 136, 12, static_cast<std::uintmax_t>(std::max<std::time_t>(writeTime, 0)));
+	std::memset(header + 148, ' ', 8);
+	header[156] = type;
+	std::memcpy(header + 257, "ustar", 6);
+	std::memcpy(header + 263, "00", 2);
+
+	unsigned checksum = 0;
+	for ( auto curByte : header )
+	{
+		checksum += static_cast<unsigned char>(curByte);
+	}
+	PutNumber(header + 148, 7, checksum);
+
+	Write(header, sizeof(header));
+}
+
+void TarWriter::WriteEntry(const std::string& name, const char* data, std::uintmax_t size, std::time_t writeTime)
+{
+	static const char sZeros[sBlockSize] = {};
+
+	//A name that does not fit the header goes into a pax extended header before the entry.
+	auto slash = name.rfind('/', 155);
+	auto fits = name.size() <= 100 || (slash != std::string::npos && name.size() - slash - 1 <= 100);
+	if ( !fits )
+	{
+		auto record = PaxPathRecord(name);
+		WriteHeader("PaxHeader/" + name.substr(name.size() - std::min<size_t>(name.size(), 80)), record.size(), writeTime, 'x');
+		Write(record.data(), record.size());
+		Write(sZeros, (sBlockSize - record.size() % sBlockSize) % sBlockSize);
+	}
+
+	WriteHeader(name, size, writeTime, '0');
+	Write(data, static_cast<size_t>(size));
+	Write(sZeros, static_cast<size_t>((sBlockSize - size % sBlockSize) % sBlockSize));
+
+	Failed_ = Failed_ || !Ofs_;
+}
+
+std::uintmax_t TarWriter::AddFile(const bfs::path& to, const bfs::path& from)
+{
+	auto name = GetEntryName(to);
+	auto writeTime = bfs::last_write_time(from);
+
+	//Read outside the lock, so workers only wait for each other while writing.
+	MappedFile contents;
+	if ( !contents.Open(from) )
+	{
+		throw bfs::filesystem_error("Can not read", from, boost::system::errc::make_error_code(boost::system::errc::io_error));
+	}
+
+	std::lock_guard<std::mutex> lock(Mutex_);
+	WriteEntry(name, contents.GetData(), contents.GetSize(), writeTime);
+	return contents.GetSize();
+}
+
+void TarWriter::AddData(const bfs::path& to, const std::string& data, std::time_t writeTime)
+{
+	auto name = GetEntryName(to);
+
+	std::lock_guard<std::mutex> lock(Mutex_);
+	WriteEntry(name, data.data(), data.size(), writeTime);
+}
+
+bool TarWriter::Close()
+{
+	static const char sZeros[sBlockSize * 2] = {};
+
+	std::lock_guard<std::mutex> lock(Mutex_);
+	if ( !Ofs_.is_open() )
+	{
+		return !Failed_;
+	}
+
+	Write(sZeros, sizeof(sZeros));
+	if ( Deflate_ )
+	{
+		Deflate_->Compress(nullptr, 0, true, Ofs_);
+	}
+
+	Ofs_.close();
+	Failed_ = Failed_ || !Ofs_;
+	if ( Failed_ )
+	{
+		std::cerr << "Can not write " << File_ << std::endl;
+	}
+	return !Failed_;
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/filesystem/path.hpp>
+
+#include <cstdint>
+#include <ctime>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace bfs = boost::filesystem;
+
+//--archive: writes the converted tree into one ustar archive instead of the file system,
+//gzip-compressed when the build defines PROJCONV_ZLIB and links zlib. Entries are named after
+//their destination below Root, so extracting the archive in Root gives the directory tree the
+//normal mode writes; no directory entries are written. Entries may be added from several
+//threads; each is written whole under a lock.
+class	TarWriter
+{
+public:
+
+	TarWriter();
+	~TarWriter();
+
+	static	bool	IsGzipAvailable();
+
+	//Prints why and returns false when the archive can not be created.
+	bool		Open(const bfs::path& file, const bfs::path& root, bool gzip);
+
+	//Adds the contents of from as destination to. Returns the size of the file.
+	std::uintmax_t	AddFile(const bfs::path& to, const bfs::path& from);
+	void		AddData(const bfs::path& to, const std::string& data, std::time_t writeTime);
+
+	//Ends the archive. Returns false when anything could not be written.
+	bool		Close();
+
+private:
+
+	TarWriter(const TarWriter&);
+	TarWriter&	operator=(const TarWriter&);
+
+	class	SDeflate;
+
+	std::string	GetEntryName(const bfs::path& to) const;
+	void		WriteHeader(const std::string& name, std::uintmax_t size, std::time_t writeTime, char type);
+	void		WriteEntry(const std::string& name, const char* data, std::uintmax_t size, std::time_t writeTime);
+	void		Write(const char* data, size_t size);
+
+	bfs::path	File_;
+	bfs::path	Root_;
+	std::mutex	Mutex_;
+	bfs::ofstream	Ofs_;
+	std::unique_ptr<SDeflate>	Deflate_;
+	bool		Failed_ = false;
+};
@@ -0,0 +1,78 @@
+#include "UnityBuild.h"
+#include "PathTable.h"
+
+#include <algorithm>
+#include <cctype>
+
+namespace
+{
+	std::string	LowerExtension(const bfs::path& file)
+	{
+		auto ret = file.extension().string();
+		std::transform(ret.begin(), ret.end(), ret.begin(), [](char value) { return static_cast<char>(std::tolower(static_cast<unsigned char>(value))); });
+		return ret;
+	}
+}
+
+UnityBuild::UnityBuild(const bfs::path& dir, const std::string& prefix, size_t batchSize) : Dir_(dir), Prefix_(prefix), BatchSize_(std::max<size_t>(batchSize, 1))
+{
+}
+
+bool UnityBuild::IsSource(const bfs::path& file)
+{
+	auto extension = LowerExtension(file);
+	return extension == ".c" || extension == ".cpp" || extension == ".cc" || extension == ".cxx" || extension == ".c++";
+}
+
+void UnityBuild::Add(int group, const bfs::path& copyPath)
+{
+	//A source listed twice would be compiled twice in one unit.
+	if ( !Added_.insert(copyPath).second )
+	{
+		return;
+	}
+
+	auto isC = LowerExtension(copyPath) == ".c";
+	auto& batch = Open_[std::make_pair(group, isC)];
+	batch.C_ = isC;
+	batch.Sources_.push_back(copyPath);
+
+	if ( batch.Sources_.size() >= BatchSize_ )
+	{
+		Close(batch);
+	}
+}
+
+void UnityBuild::Finish()
+{
+	for ( auto& curBatch : Open_ )
+	{
+		Close(curBatch.second);
+	}
+}
+
+void UnityBuild::Close(SBatch& batch)
+{
+	if ( batch.Sources_.empty() )
+	{
+		return;
+	}
+
+	auto& paths = PathTable::GetInstance();
+
+	SFile file;
+	file.Path_ = Dir_ / (Prefix_ + "_unity" + std::to_string(static_cast<unsigned long long>(Files_.size())) + (batch.C_ ? ".c" : ".cpp"));
+	file.SourceCount_ = batch.Sources_.size();
+	file.Text_ = "//Generated by ProjConvertor. Do not edit.\n";
+
+	auto dir = paths.Intern(Dir_);
+	for ( auto& curSource : batch.Sources_ )
+	{
+		auto include = paths.Relative(dir, paths.Intern(curSource));
+		std::replace(include.begin(), include.end(), '\\', '/');
+		file.Text_ += "#include \"" + include + "\"\n";
+	}
+
+	Files_.push_back(file);
+	batch.Sources_.clear();
+}
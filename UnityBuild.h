@@ -0,0 +1,60 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+namespace bfs = boost::filesystem;
+
+//Groups a project's translation units into generated unity sources of at most BatchSize files
+//each. Sources are grouped by key (SrcDirectories root and language), so a batch only combines
+//files from one root. A unity source is a list of #include lines naming the copied originals
+//relative to itself.
+class	UnityBuild
+{
+public:
+
+	class	SFile
+	{
+	public:
+		bfs::path	Path_;
+		std::string	Text_;
+		size_t		SourceCount_ = 0;
+	};
+
+	//Unity sources are written to dir as <prefix>_unity<N>.cpp (or .c).
+	UnityBuild(const bfs::path& dir, const std::string& prefix, size_t batchSize);
+
+	//C sources are batched apart from C++ ones.
+	void		Add(int group, const bfs::path& copyPath);
+
+	//Closes every batch that is not full yet.
+	void		Finish();
+
+	//Every unity source completed so far, in order.
+	const std::vector<SFile>&	GetFiles() const { return Files_; }
+
+	//Matches the languages MSBuild compiles as C or C++: .c, .cpp, .cc, .cxx, .c++.
+	static	bool	IsSource(const bfs::path& file);
+
+private:
+
+	class	SBatch
+	{
+	public:
+		std::vector<bfs::path>	Sources_;
+		bool		C_ = false;
+	};
+
+	void		Close(SBatch& batch);
+
+	bfs::path	Dir_;
+	std::string	Prefix_;
+	size_t		BatchSize_;
+	std::map<std::pair<int, bool>, SBatch>	Open_;
+	std::set<bfs::path>	Added_;
+	std::vector<SFile>	Files_;
+};
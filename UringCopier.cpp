@@ -0,0 +1,594 @@
+#include "UringCopier.h"
+
+#if defined(__linux__) && defined(__has_include)
+#if __has_include(<linux/io_uring.h>)
+#define PROJCONV_IO_URING
+#endif
+#endif
+
+#ifdef PROJCONV_IO_URING
+#include <linux/io_uring.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#endif
+
+#ifdef PROJCONV_IO_URING
+
+namespace
+{
+	const size_t	sBufferSize = 64 * 1024;
+
+	//user_data is slot << 1 | kind. A slot has at most one step in flight; closes are queued
+	//and only counted.
+	const std::uint64_t	sStepKind = 0;
+	const std::uint64_t	sCloseKind = 1;
+
+	enum class	EStep
+	{
+		Unlink,
+		Stat,
+		OpenFrom,
+		OpenTo,
+		Read,
+		Write,
+	};
+
+	class	SSlot
+	{
+	public:
+		bool		Busy_ = false;
+		size_t		FileIndex_ = 0;
+		EStep		Step_ = EStep::Unlink;
+		std::string	From_;
+		std::string	To_;
+		int			FromFd_ = -1;
+		int			ToFd_ = -1;
+		struct statx	Stat_;
+		std::uint64_t	Offset_ = 0;
+		size_t		Filled_ = 0;
+		size_t		Written_ = 0;
+		std::vector<char>	Buffer_;
+	};
+}
+
+class	UringCopier::SRing
+{
+public:
+
+	~SRing()
+	{
+		if ( Sqes_ != MAP_FAILED )
+		{
+			::munmap(Sqes_, SqesSize_);
+		}
+		if ( CqPtr_ != MAP_FAILED && CqPtr_ != SqPtr_ )
+		{
+			::munmap(CqPtr_, CqSize_);
+		}
+		if ( SqPtr_ != MAP_FAILED )
+		{
+			::munmap(SqPtr_, SqSize_);
+		}
+		if ( Fd_ >= 0 )
+		{
+			::close(Fd_);
+		}
+
+		//Closing the ring cancels what is still in flight; only then may its buffers go.
+		Abandoned_.clear();
+	}
+
+	//Slots with operations that could not be reaped, kept until the ring is closed.
+	void	Abandon(std::vector<SSlot>& slots)
+	{
+		Abandoned_.swap(slots);
+	}
+
+	bool	Init(unsigned entries)
+	{
+		io_uring_params params;
+		std::memset(&params, 0, sizeof(params));
+
+		Fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+		if ( Fd_ < 0 )
+		{
+			return false;
+		}
+
+		SqSize_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+		CqSize_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+
+		auto singleMap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+		if ( singleMap )
+		{
+			SqSize_ = CqSize_ = std::max(SqSize_, CqSize_);
+		}
+
+		SqPtr_ = ::mmap(nullptr, SqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQ_RING);
+		if ( SqPtr_ == MAP_FAILED )
+		{
+			return false;
+		}
+
+		CqPtr_ = singleMap ? SqPtr_ : ::mmap(nullptr, CqSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_CQ_RING);
+		if ( CqPtr_ == MAP_FAILED )
+		{
+			return false;
+		}
+
+		SqesSize_ = params.sq_entries * sizeof(io_uring_sqe);
+		Sqes_ = ::mmap(nullptr, SqesSize_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, Fd_, IORING_OFF_SQES);
+		if ( Sqes_ == MAP_FAILED )
+		{
+			return false;
+		}
+
+		auto sq = static_cast<char*>(SqPtr_);
+		SqHead_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+		SqTail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+		SqMask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+		SqEntries_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_entries);
+		SqArray_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+
+		auto cq = static_cast<char*>(CqPtr_);
+		CqHead_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+		CqTail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+		CqMask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+		Cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+
+		return Probe();
+	}
+
+	//Copies sqe into the submission queue. Returns false when the queue is full.
+	bool	Queue(const io_uring_sqe& sqe)
+	{
+		auto head = __atomic_load_n(SqHead_, __ATOMIC_ACQUIRE);
+		auto tail = *SqTail_;
+		if ( tail - head >= SqEntries_ )
+		{
+			return false;
+		}
+
+		auto index = tail & SqMask_;
+		static_cast<io_uring_sqe*>(Sqes_)[index] = sqe;
+		SqArray_[index] = index;
+		__atomic_store_n(SqTail_, tail + 1, __ATOMIC_RELEASE);
+
+		++Pending_;
+		return true;
+	}
+
+	//Submits what was queued and waits for at least one completion.
+	bool	SubmitAndWait()
+	{
+		for ( ;; )
+		{
+			auto ret = ::syscall(__NR_io_uring_enter, Fd_, Pending_, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+			if ( ret >= 0 )
+			{
+				Pending_ -= static_cast<unsigned>(ret);
+				return true;
+			}
+			if ( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+			{
+				return false;
+			}
+		}
+	}
+
+	//Waits for at least one completion without submitting what is still queued.
+	bool	Wait()
+	{
+		for ( ;; )
+		{
+			if ( ::syscall(__NR_io_uring_enter, Fd_, 0, 1, IORING_ENTER_GETEVENTS, nullptr, 0) >= 0 )
+			{
+				return true;
+			}
+			if ( errno != EINTR && errno != EAGAIN && errno != EBUSY )
+			{
+				return false;
+			}
+		}
+	}
+
+	//Queued entries the kernel has not taken yet.
+	unsigned	GetUnsubmitted() const { return Pending_; }
+
+	template<typename Func>
+	void	Reap(Func func)
+	{
+		auto head = *CqHead_;
+		auto tail = __atomic_load_n(CqTail_, __ATOMIC_ACQUIRE);
+		while ( head != tail )
+		{
+			auto& cqe = Cqes_[head & CqMask_];
+			func(cqe.user_data, cqe.res);
+			++head;
+		}
+		__atomic_store_n(CqHead_, head, __ATOMIC_RELEASE);
+	}
+
+private:
+
+	//Every opcode a copy uses must be supported; unlinkat needs 5.11.
+	bool	Probe()
+	{
+		const unsigned opCount = 64;
+		std::vector<char> buffer(sizeof(io_uring_probe) + opCount * sizeof(io_uring_probe_op), 0);
+		auto probe = reinterpret_cast<io_uring_probe*>(buffer.data());
+
+		if ( ::syscall(__NR_io_uring_register, Fd_, IORING_REGISTER_PROBE, probe, opCount) < 0 )
+		{
+			return false;
+		}
+
+		for ( auto curOp : { IORING_OP_UNLINKAT, IORING_OP_STATX, IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE, IORING_OP_CLOSE } )
+		{
+			if ( curOp > probe->last_op || (probe->ops[curOp].flags & IO_URING_OP_SUPPORTED) == 0 )
+			{
+				return false;
+			}
+		}
+
+		return true;
+	}
+
+	int			Fd_ = -1;
+	std::vector<SSlot>	Abandoned_;
+	void*		SqPtr_ = MAP_FAILED;
+	size_t		SqSize_ = 0;
+	void*		CqPtr_ = MAP_FAILED;
+	size_t		CqSize_ = 0;
+	void*		Sqes_ = MAP_FAILED;
+	size_t		SqesSize_ = 0;
+	unsigned*	SqHead_ = nullptr;
+	unsigned*	SqTail_ = nullptr;
+	unsigned	SqMask_ = 0;
+	unsigned	SqEntries_ = 0;
+	unsigned*	SqArray_ = nullptr;
+	unsigned*	CqHead_ = nullptr;
+	unsigned*	CqTail_ = nullptr;
+	unsigned	CqMask_ = 0;
+	io_uring_cqe*	Cqes_ = nullptr;
+	unsigned	Pending_ = 0;
+};
+
+UringCopier::UringCopier(unsigned queueDepth) : QueueDepth_(std::max(1u, queueDepth))
+{
+	//Room for one step and two closes per slot.
+	std::unique_ptr<SRing> ring(new SRing);
+	if ( ring->Init(QueueDepth_ * 4) )
+	{
+		Ring_ = std::move(ring);
+	}
+}
+
+UringCopier::~UringCopier()
+{
+}
+
+bool UringCopier::IsAvailable() const
+{
+	return Ring_ != nullptr;
+}
+
+void UringCopier::Copy(std::vector<SFile>& files)
+{
+	for ( auto& curFile : files )
+	{
+		curFile.Copied_ = false;
+	}
+
+	if ( !Ring_ )
+	{
+		return;
+	}
+
+	auto& ring = *Ring_;
+
+	std::vector<SSlot> slots(std::min<size_t>(QueueDepth_, files.size()));
+	size_t nextFile = 0;
+	size_t stepsInFlight = 0, closesInFlight = 0;
+
+	auto queueStep = [&](size_t slotIndex, io_uring_sqe& sqe) -> bool
+	{
+		sqe.user_data = (static_cast<std::uint64_t>(slotIndex) << 1) | sStepKind;
+		if ( !ring.Queue(sqe) )
+		{
+			return false;
+		}
+		++stepsInFlight;
+		return true;
+	};
+
+	auto closeFd = [&](int& fd)
+	{
+		if ( fd < 0 )
+		{
+			return;
+		}
+
+		io_uring_sqe sqe;
+		std::memset(&sqe, 0, sizeof(sqe));
+		sqe.opcode = IORING_OP_CLOSE;
+		sqe.fd = fd;
+		sqe.user_data = sCloseKind;
+		if ( ring.Queue(sqe) )
+		{
+			++closesInFlight;
+		}
+		else
+		{
+			::close(fd);
+		}
+		fd = -1;
+	};
+
+	auto finish = [&](SSlot& slot, bool copied)
+	{
+		files[slot.FileIndex_].Copied_ = copied;
+		closeFd(slot.FromFd_);
+		closeFd(slot.ToFd_);
+		slot.Busy_ = false;
+	};
+
+	//Queues the current step of slot. A step that can not be queued fails the file.
+	auto queue = [&](size_t slotIndex)
+	{
+		auto& slot = slots[slotIndex];
+
+		io_uring_sqe sqe;
+		std::memset(&sqe, 0, sizeof(sqe));
+
+		switch ( slot.Step_ )
+		{
+		case EStep::Unlink:
+			sqe.opcode = IORING_OP_UNLINKAT;
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.To_.c_str());
+			break;
+		case EStep::Stat:
+			sqe.opcode = IORING_OP_STATX;
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.From_.c_str());
+			sqe.len = STATX_MODE | STATX_SIZE;
+			sqe.off = reinterpret_cast<std::uint64_t>(&slot.Stat_);
+			break;
+		case EStep::OpenFrom:
+			sqe.opcode = IORING_OP_OPENAT;
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.From_.c_str());
+			sqe.open_flags = O_RDONLY | O_CLOEXEC;
+			break;
+		case EStep::OpenTo:
+			sqe.opcode = IORING_OP_OPENAT;
+			sqe.fd = AT_FDCWD;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.To_.c_str());
+			sqe.open_flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+			sqe.len = slot.Stat_.stx_mode & 0777;
+			break;
+		case EStep::Read:
+			sqe.opcode = IORING_OP_READ;
+			sqe.fd = slot.FromFd_;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.Buffer_.data());
+			sqe.len = static_cast<unsigned>(slot.Buffer_.size());
+			sqe.off = slot.Offset_;
+			break;
+		case EStep::Write:
+			sqe.opcode = IORING_OP_WRITE;
+			sqe.fd = slot.ToFd_;
+			sqe.addr = reinterpret_cast<std::uint64_t>(slot.Buffer_.data() + slot.Written_);
+			sqe.len = static_cast<unsigned>(slot.Filled_ - slot.Written_);
+			sqe.off = slot.Offset_ + slot.Written_;
+			break;
+		}
+
+		if ( !queueStep(slotIndex, sqe) )
+		{
+			finish(slot, false);
+		}
+	};
+
+	auto start = [&](size_t slotIndex)
+	{
+		auto& slot = slots[slotIndex];
+		slot.Busy_ = true;
+		slot.FileIndex_ = nextFile++;
+		slot.Step_ = EStep::Unlink;
+		slot.From_ = files[slot.FileIndex_].From_.string();
+		slot.To_ = files[slot.FileIndex_].To_.string();
+		slot.Offset_ = 0;
+		if ( slot.Buffer_.empty() )
+		{
+			slot.Buffer_.resize(sBufferSize);
+		}
+		queue(slotIndex);
+	};
+
+	auto advance = [&](size_t slotIndex, int res)
+	{
+		auto& slot = slots[slotIndex];
+
+		switch ( slot.Step_ )
+		{
+		case EStep::Unlink:
+			if ( res < 0 && res != -ENOENT )
+			{
+				finish(slot, false);
+				return;
+			}
+			slot.Step_ = EStep::Stat;
+			break;
+		case EStep::Stat:
+			if ( res < 0 )
+			{
+				finish(slot, false);
+				return;
+			}
+			slot.Step_ = EStep::OpenFrom;
+			break;
+		case EStep::OpenFrom:
+			if ( res < 0 )
+			{
+				finish(slot, false);
+				return;
+			}
+			slot.FromFd_ = res;
+			slot.Step_ = EStep::OpenTo;
+			break;
+		case EStep::OpenTo:
+			if ( res < 0 )
+			{
+				finish(slot, false);
+				return;
+			}
+			slot.ToFd_ = res;
+			if ( slot.Stat_.stx_size == 0 )
+			{
+				finish(slot, true);
+				return;
+			}
+			slot.Step_ = EStep::Read;
+			break;
+		case EStep::Read:
+			if ( res < 0 )
+			{
+				finish(slot, false);
+				return;
+			}
+			if ( res == 0 )
+			{
+				finish(slot, true);
+				return;
+			}
+			slot.Filled_ = static_cast<size_t>(res);
+			slot.Written_ = 0;
+			slot.Step_ = EStep::Write;
+			break;
+		case EStep::Write:
+			if ( res <= 0 )
+			{
+				finish(slot, false);
+				return;
+			}
+			slot.Written_ += static_cast<size_t>(res);
+			if ( slot.Written_ < slot.Filled_ )
+			{
+				break;
+			}
+
+			//The size from statx saves the read that would only return 0.
+			slot.Offset_ += slot.Filled_;
+			if ( slot.Offset_ >= slot.Stat_.stx_size )
+			{
+				finish(slot, true);
+				return;
+			}
+			slot.Step_ = EStep::Read;
+			break;
+		}
+
+		queue(slotIndex);
+	};
+
+	for ( size_t index = 0; index < slots.size(); ++index )
+	{
+		start(index);
+	}
+
+	while ( stepsInFlight > 0 || closesInFlight > 0 )
+	{
+		if ( !ring.SubmitAndWait() )
+		{
+			//The ring is unusable; what is still in flight is left to the caller. Steps the kernel
+			//already took may still read into or write from the slots, so they are reaped first.
+			size_t submitted = stepsInFlight + closesInFlight - ring.GetUnsubmitted();
+			while ( submitted > 0 && ring.Wait() )
+			{
+				ring.Reap([&](std::uint64_t, int) { submitted -= submitted > 0 ? 1 : 0; });
+			}
+
+			for ( auto& curSlot : slots )
+			{
+				if ( curSlot.Busy_ )
+				{
+					if ( curSlot.FromFd_ >= 0 )
+					{
+						::close(curSlot.FromFd_);
+					}
+					if ( curSlot.ToFd_ >= 0 )
+					{
+						::close(curSlot.ToFd_);
+					}
+				}
+			}
+
+			if ( submitted > 0 )
+			{
+				//Can not be reaped either: the slots must outlive the ring, which frees them.
+				ring.Abandon(slots);
+			}
+			Ring_.reset();
+			return;
+		}
+
+		ring.Reap([&](std::uint64_t userData, int res)
+		{
+			if ( (userData & 1) == sCloseKind )
+			{
+				--closesInFlight;
+				return;
+			}
+
+			--stepsInFlight;
+			advance(static_cast<size_t>(userData >> 1), res);
+		});
+
+		for ( size_t index = 0; index < slots.size() && nextFile < files.size(); ++index )
+		{
+			if ( !slots[index].Busy_ )
+			{
+				start(index);
+			}
+		}
+	}
+}
+
+#else
+
+class	UringCopier::SRing
+{
+};
+
+UringCopier::UringCopier(unsigned queueDepth) : QueueDepth_(queueDepth)
+{
+}
+
+UringCopier::~UringCopier()
+{
+}
+
+bool UringCopier::IsAvailable() const
+{
+	return false;
+}
+
+void UringCopier::Copy(std::vector<SFile>& files)
+{
+	for ( auto& curFile : files )
+	{
+		curFile.Copied_ = false;
+	}
+}
+
+#endif
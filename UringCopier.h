@@ -0,0 +1,44 @@
+#pragma once
+
+#include <boost/filesystem/path.hpp>
+
+#include <memory>
+#include <vector>
+
+//Copies batches of files through one io_uring: every step of a copy (unlink, statx, open, read,
+//write, close) is queued instead of being a blocking syscall, and up to QueueDepth files are in
+//flight per io_uring_enter. Meant for the tens of thousands of small headers a project has.
+//Linux only, through the raw syscalls (no liburing). IsAvailable() is false on other platforms
+//or when the kernel refuses io_uring; callers then copy with bfs::copy_file.
+class	UringCopier
+{
+public:
+
+	class	SFile
+	{
+	public:
+		boost::filesystem::path	From_;
+		boost::filesystem::path	To_;
+		bool		Copied_ = false;
+	};
+
+	explicit	UringCopier(unsigned queueDepth = 32);
+	~UringCopier();
+
+	bool		IsAvailable() const;
+
+	//Copies every file and sets its Copied_. The destination is unlinked first, as
+	//FileMaterializer does. A file that failed at any step is left for the caller to copy the
+	//portable way.
+	void		Copy(std::vector<SFile>& files);
+
+private:
+
+	UringCopier(const UringCopier&);
+	UringCopier&	operator=(const UringCopier&);
+
+	class	SRing;
+
+	std::unique_ptr<SRing>	Ring_;
+	unsigned	QueueDepth_;
+};
@@ -0,0 +1,487 @@
+#include "Watcher.h"
+#include "DirWalker.h"
+#include "PathTable.h"
+
+#include <algorithm>
+#include <iostream>
+#include <map>
+#include <set>
+
+#ifdef __linux__
+#include <poll.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <chrono>
+#include <cstring>
+#endif
+
+#ifdef __linux__
+
+namespace
+{
+	//A batch is applied once no event arrived for sQuietMs, or after sMaxBatchMs at the latest.
+	const int	sQuietMs = 300;
+	const int	sMaxBatchMs = 3000;
+
+	class	SInotify
+	{
+	public:
+
+		SInotify() : Fd_(::inotify_init1(IN_CLOEXEC | IN_NONBLOCK)) {}
+		~SInotify() { if ( Fd_ >= 0 ) ::close(Fd_); }
+
+		bool	IsValid() const { return Fd_ >= 0; }
+
+		void	AddDir(const bfs::path& dir)
+		{
+			auto wd = ::inotify_add_watch(Fd_, dir.c_str(), IN_CLOSE_WRITE | IN_MOVED_TO | IN_CREATE | IN_DELETE | IN_MOVED_FROM | IN_ONLYDIR);
+			if ( wd < 0 )
+			{
+				if ( !WarnedLimit_ && errno == ENOSPC )
+				{
+					std::cerr << "Out of inotify watches (fs.inotify.max_user_watches), some directories are not watched." << std::endl;
+					WarnedLimit_ = true;
+				}
+				return;
+			}
+
+			Dirs_[wd] = dir;
+		}
+
+		//Watches root and every directory below it. Files found go to files when it is given,
+		//for directories that appeared after the watch started.
+		void	AddTree(const bfs::path& root, std::set<PathTable::ID>* files)
+		{
+			boost::system::error_code ec;
+			if ( !bfs::is_directory(root, ec) )
+			{
+				return;
+			}
+
+			AddDir(root);
+
+			bfs::recursive_directory_iterator itor(root, ec), end;
+			for ( ; !ec && itor != end; itor.increment(ec) )
+			{
+				if ( bfs::is_directory(itor->status()) )
+				{
+					AddDir(itor->path());
+				}
+				else if ( files )
+				{
+					files->insert(PathTable::GetInstance().Intern(itor->path()));
+				}
+			}
+		}
+
+		//Greater than 0 when events are pending, 0 on timeout, negative on error with errno set.
+		int		Wait(int timeoutMs)
+		{
+			pollfd pfd;
+			pfd.fd = Fd_;
+			pfd.events = POLLIN;
+			pfd.revents = 0;
+
+			for ( ;; )
+			{
+				auto ret = ::poll(&pfd, 1, timeoutMs);
+				if ( ret >= 0 || errno != EINTR )
+				{
+					return ret;
+				}
+			}
+		}
+
+		//Drains the pending events into changed. overflow is set when the kernel dropped some.
+		void	Read(std::set<PathTable::ID>& changed, bool& overflow)
+		{
+			alignas(inotify_event) char buffer[64 * 1024];
+
+			for ( ;; )
+			{
+				auto length = ::read(Fd_, buffer, sizeof(buffer));
+				if ( length <= 0 )
+				{
+					return;
+				}
+
+				for ( auto ptr = buffer; ptr < buffer + length; )
+				{
+					auto event = reinterpret_cast<const inotify_event*>(ptr);
+					ptr += sizeof(inotify_event) + event->len;
+
+					if ( event->mask & IN_Q_OVERFLOW )
+					{
+						overflow = true;
+						continue;
+					}
+
+					auto dir = Dirs_.find(event->wd);
+					if ( dir == Dirs_.end() || event->len == 0 )
+					{
+						continue;
+					}
+
+					auto path = dir->second / event->name;
+					if ( event->mask & IN_ISDIR )
+					{
+						if ( event->mask & (IN_CREATE | IN_MOVED_TO) )
+						{
+							AddTree(path, &changed);
+						}
+					}
+					else if ( event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO | IN_DELETE | IN_MOVED_FROM) )
+					{
+						changed.insert(PathTable::GetInstance().Intern(path));
+					}
+				}
+			}
+		}
+
+	private:
+
+		int			Fd_;
+		std::map<int, bfs::path>	Dirs_;
+		bool		WarnedLimit_ = false;
+	};
+
+	class	SWatchedCopy
+	{
+	public:
+		size_t		ProjIndex_ = 0;
+		FileMaterializer::SCopyItem	Item_;
+		bool		InProject_ = false;	//An item of the .vcxproj, not an AdditionalCopyFiles copy.
+	};
+
+	typedef	std::map<PathTable::ID, std::vector<SWatchedCopy>>	CopyIndex;
+
+	class	SWatchedFolder
+	{
+	public:
+		size_t		ProjIndex_ = 0;
+		const SProjectInfo::SCopyFolder*	Folder_ = nullptr;
+		PathTable::ID	From_ = PathTable::sEmpty;
+	};
+
+	bool	HasCopy(const CopyIndex& index, PathTable::ID from, size_t projIndex, const bfs::path& to)
+	{
+		auto itor = index.find(from);
+		if ( itor == index.end() )
+		{
+			return false;
+		}
+
+		for ( auto& curCopy : itor->second )
+		{
+			if ( curCopy.ProjIndex_ == projIndex && curCopy.Item_.To_ == to )
+			{
+				return true;
+			}
+		}
+		return false;
+	}
+
+	//Source file -> every copy made of it. found holds the files that appeared in an
+	//AdditionalCopyFiles <Folder> since the first conversion.
+	void	BuildCopyIndex(const ProjectList& projList, const std::vector<ResolutionTable>& tables, const CopyIndex& found, CopyIndex& index)
+	{
+		auto& paths = PathTable::GetInstance();
+
+		index.clear();
+		for ( size_t projIndex = 0; projIndex < projList.size(); ++projIndex )
+		{
+			SWatchedCopy copy;
+			copy.ProjIndex_ = projIndex;
+			copy.InProject_ = true;
+
+			for ( auto& curFile : tables[projIndex] )
+			{
+				if ( curFile.second.CopyPath_.empty() || curFile.second.Pruned_ )
+				{
+					continue;
+				}
+
+				copy.Item_.From_ = curFile.second.From_;
+				copy.Item_.To_ = curFile.second.CopyPath_;
+				copy.Item_.Mode_ = curFile.second.Mode_;
+				index[paths.Intern(copy.Item_.From_)].push_back(copy);
+			}
+
+			copy.InProject_ = false;
+			for ( auto& curCpy : projList[projIndex].AdditionalCopyList )
+			{
+				copy.Item_ = curCpy;
+				index[paths.Intern(curCpy.From_)].push_back(copy);
+			}
+		}
+
+		for ( auto& curFound : found )
+		{
+			for ( auto& curCopy : curFound.second )
+			{
+				if ( !HasCopy(index, curFound.first, curCopy.ProjIndex_, curCopy.Item_.To_) )
+				{
+					index[curFound.first].push_back(curCopy);
+				}
+			}
+		}
+	}
+
+	//Walks folder again when a changed file lies below it, and adds the changed files that are
+	//not copied yet to index and to found.
+	void	WalkFolder(const ProjectList& projList, const SWatchedFolder& folder, const std::set<PathTable::ID>& changed, CopyIndex& index, CopyIndex& found)
+	{
+		auto& paths = PathTable::GetInstance();
+
+		auto within = std::any_of(changed.begin(), changed.end(), [&](PathTable::ID path) { return path != folder.From_ && paths.IsWithin(path, folder.From_); });
+		if ( !within )
+		{
+			return;
+		}
+
+		DirWalker walker;
+		walker.SetFilter(folder.Folder_->Include_, folder.Folder_->Exclude_);
+
+		SWatchedCopy copy;
+		copy.ProjIndex_ = folder.ProjIndex_;
+		copy.Item_.Mode_ = folder.Folder_->Mode_;
+
+		for ( auto& curFile : walker.Walk(folder.Folder_->From_, projList[folder.ProjIndex_].CopyJobs) )
+		{
+			auto from = paths.Intern(curFile.Path_);
+			copy.Item_.From_ = curFile.Path_;
+			copy.Item_.To_ = folder.Folder_->To_ / curFile.RelPath_;
+			if ( changed.count(from) == 0 || HasCopy(index, from, copy.ProjIndex_, copy.Item_.To_) )
+			{
+				continue;
+			}
+
+			index[from].push_back(copy);
+			found[from].push_back(copy);
+		}
+	}
+}
+
+bool WatchProjects(const ProjectList& projList, std::vector<ResolutionTable>& tables)
+{
+	SInotify inotify;
+	if ( !inotify.IsValid() )
+	{
+		std::cerr << "Can not start inotify." << std::endl;
+		return false;
+	}
+
+	auto& paths = PathTable::GetInstance();
+
+	std::vector<PathTable::ID> vcxFiles, filterFiles;
+	std::set<bfs::path> copyDirs;
+	std::vector<SWatchedFolder> folders;
+	for ( size_t projIndex = 0; projIndex < projList.size(); ++projIndex )
+	{
+		auto& curProj = projList[projIndex];
+		vcxFiles.push_back(paths.Intern(curProj.VCXProjectPath.From_ / (curProj.TargetName + ".vcxproj")));
+		filterFiles.push_back(paths.Intern(curProj.VCXProjectPath.From_ / (curProj.TargetName + ".vcxproj.filters")));
+
+		inotify.AddDir(curProj.VCXProjectPath.From_);
+		for ( auto& curSrcDir : curProj.SrcList )
+		{
+			inotify.AddTree(curSrcDir.From_, nullptr);
+		}
+		for ( auto& curCpy : curProj.AdditionalCopyList )
+		{
+			copyDirs.insert(curCpy.From_.parent_path());
+		}
+
+		//Folders are watched whole, so files added to them later are copied too.
+		for ( auto& curFolder : curProj.AdditionalCopyFolders )
+		{
+			inotify.AddTree(curFolder.From_, nullptr);
+
+			SWatchedFolder folder;
+			folder.ProjIndex_ = projIndex;
+			folder.Folder_ = &curFolder;
+			folder.From_ = paths.Intern(curFolder.From_);
+			folders.push_back(folder);
+		}
+	}
+	for ( auto& curDir : copyDirs )
+	{
+		inotify.AddDir(curDir);
+	}
+
+	CopyIndex copyIndex, foundCopies;
+	BuildCopyIndex(projList, tables, foundCopies, copyIndex);
+
+	std::cout << "Watching " << projList.size() << " projects, press Ctrl+C to stop." << std::endl;
+
+	for ( ;; )
+	{
+		if ( inotify.Wait(-1) < 0 )
+		{
+			std::cerr << "Waiting for inotify events failed: " << std::strerror(errno) << std::endl;
+			return false;
+		}
+
+		std::set<PathTable::ID> changed;
+		auto overflow = false;
+
+		auto batchStart = std::chrono::steady_clock::now();
+		do
+		{
+			inotify.Read(changed, overflow);
+		} while ( std::chrono::steady_clock::now() - batchStart < std::chrono::milliseconds(sMaxBatchMs) && inotify.Wait(sQuietMs) > 0 );
+
+		std::set<size_t> rebuild, refilter;
+		for ( size_t projIndex = 0; projIndex < projList.size(); ++projIndex )
+		{
+			//Lost events: every project is converted again, incrementally.
+			if ( overflow || changed.count(vcxFiles[projIndex]) > 0 )
+			{
+				rebuild.insert(projIndex);
+			}
+			else if ( changed.count(filterFiles[projIndex]) > 0 )
+			{
+				refilter.insert(projIndex);
+			}
+		}
+
+		for ( auto& curFolder : folders )
+		{
+			try
+			{
+				WalkFolder(projList, curFolder, changed, copyIndex, foundCopies);
+			}
+			catch ( std::exception& exp )
+			{
+				std::cerr << exp.what() << std::endl;
+			}
+		}
+
+		//The precompiled header and the pruned headers follow from what the sources include, so
+		//a changed item of an AutoPch or PruneIncludes project plans it again.
+		for ( auto& curPath : changed )
+		{
+			auto itor = copyIndex.find(curPath);
+			if ( itor == copyIndex.end() )
+			{
+				continue;
+			}
+
+			for ( auto& curCopy : itor->second )
+			{
+				if ( curCopy.InProject_ && (projList[curCopy.ProjIndex_].AutoPch || projList[curCopy.ProjIndex_].PruneIncludes) )
+				{
+					rebuild.insert(curCopy.ProjIndex_);
+				}
+			}
+		}
+
+		//Projects being rebuilt copy their changed files themselves. Projects may use different
+		//stores, so copies are grouped by store. A source deleted or renamed away takes its
+		//copies with it.
+		std::map<bfs::path, FileMaterializer> materializers;
+		size_t removed = 0;
+		for ( auto& curPath : changed )
+		{
+			auto itor = copyIndex.find(curPath);
+			if ( itor == copyIndex.end() )
+			{
+				continue;
+			}
+
+			boost::system::error_code ec;
+			auto gone = !bfs::exists(itor->second.front().Item_.From_, ec);
+
+			for ( auto& curCopy : itor->second )
+			{
+				if ( rebuild.count(curCopy.ProjIndex_) == 0 )
+				{
+					if ( gone )
+					{
+						if ( bfs::remove(curCopy.Item_.To_, ec) )
+						{
+							++removed;
+						}
+						continue;
+					}
+
+					auto& storePath = projList[curCopy.ProjIndex_].StorePath;
+					auto itor = materializers.find(storePath);
+					if ( itor == materializers.end() )
+					{
+						itor = materializers.emplace(storePath, FileMaterializer()).first;
+						itor->second.SetStore(storePath);
+					}
+					itor->second.Add(curCopy.Item_.From_, curCopy.Item_.To_, curCopy.Item_.Mode_);
+				}
+			}
+		}
+
+		size_t updated = 0;
+		for ( auto& curMaterializer : materializers )
+		{
+			try
+			{
+				curMaterializer.second.Run();
+				updated += curMaterializer.second.GetCopiedCount();
+			}
+			catch ( std::exception& exp )
+			{
+				std::cerr << exp.what() << std::endl;
+			}
+		}
+
+		if ( !materializers.empty() )
+		{
+			std::cout << "Updated " << updated << " files." << std::endl;
+		}
+		if ( removed > 0 )
+		{
+			std::cout << "Removed " << removed << " files." << std::endl;
+		}
+
+		for ( auto curIndex : rebuild )
+		{
+			try
+			{
+				BuildProject(projList[curIndex], tables[curIndex]);
+			}
+			catch ( std::exception& exp )
+			{
+				std::cerr << exp.what() << std::endl;
+			}
+		}
+
+		for ( auto curIndex : refilter )
+		{
+			try
+			{
+				if ( BuildFilter(projList[curIndex], tables[curIndex]) )
+				{
+					std::cout << projList[curIndex].TargetName << ": filters updated." << std::endl;
+				}
+			}
+			catch ( std::exception& exp )
+			{
+				std::cerr << exp.what() << std::endl;
+			}
+		}
+
+		if ( !rebuild.empty() )
+		{
+			BuildCopyIndex(projList, tables, foundCopies, copyIndex);
+		}
+	}
+}
+
+#else
+
+bool WatchProjects(const ProjectList&, std::vector<ResolutionTable>&)
+{
+	std::cerr << "--watch needs inotify and is only supported on Linux." << std::endl;
+	return false;
+}
+
+#endif
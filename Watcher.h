@@ -0,0 +1,15 @@
+#pragma once
+
+#include "ProjConvertor.h"
+
+//--watch: keeps the converted tree in sync after the first conversion. Watches every
+//VCXProjectPath.From_ and, recursively, every SrcDirectories and AdditionalCopyFiles <Folder>
+//root. A changed source file is copied again on its own, and a file added to a <Folder> is
+//copied when its filter takes it; a changed .vcxproj reruns that project (its copies are
+//incremental, so only new or changed files are copied), and a changed .filters reruns
+//BuildFilter only. A changed item of a project with a generated precompiled header reruns the
+//project too, which plans the header again; unity sources only depend on the .vcxproj. Events
+//are batched until the tree has been quiet for a moment, so a large checkout is one update.
+//Needs inotify (Linux); elsewhere it reports that and returns false. Runs until interrupted.
+//tables holds the resolution table of every project from the first conversion.
+bool	WatchProjects(const ProjectList& projList, std::vector<ResolutionTable>& tables);
@@ -0,0 +1,983 @@
+#include "XmlStream.h"
+
+#include <boost/property_tree/xml_parser.hpp>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace boost::property_tree;
+
+namespace
+{
+	bool	IsSpace(int ch)
+	{
+		return ch == ' ' || ch == '\t' || ch == '\r' || ch == '\n';
+	}
+
+	void	AppendUtf8(std::string& out, unsigned long code)
+	{
+		if ( code < 0x80 )
+		{
+			out += static_cast<char>(code);
+		}
+		else if ( code < 0x800 )
+		{
+			out += static_cast<char>(0xC0 | (code >> 6));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else if ( code < 0x10000 )
+		{
+			out += static_cast<char>(0xE0 | (code >> 12));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+		else
+		{
+			out += static_cast<char>(0xF0 | (code >> 18));
+			out += static_cast<char>(0x80 | ((code >> 12) & 0x3F));
+			out += static_cast<char>(0x80 | ((code >> 6) & 0x3F));
+			out += static_cast<char>(0x80 | (code & 0x3F));
+		}
+	}
+
+	//Appends the character the reference name (between '&' and ';') stands for. Returns false
+	//for unknown names.
+	bool	AppendEntity(std::string& out, const std::string& name)
+	{
+		if ( name == "amp" )
+		{
+			out += '&';
+		}
+		else if ( name == "lt" )
+		{
+			out += '<';
+		}
+		else if ( name == "gt" )
+		{
+			out += '>';
+		}
+		else if ( name == "quot" )
+		{
+			out += '"';
+		}
+		else if ( name == "apos" )
+		{
+			out += '\'';
+		}
+		else if ( name.size() > 1 && name[0] == '#' )
+		{
+			auto hex = name[1] == 'x';
+			AppendUtf8(out, std::strtoul(name.c_str() + (hex ? 2 : 1), nullptr, hex ? 16 : 10));
+		}
+		else
+		{
+			return false;
+		}
+
+		return true;
+	}
+
+	//Same as XmlReader::ReadEntity over memory. pos is just past the '&'.
+	void	DecodeEntity(const char*& pos, const char* end, std::string& out)
+	{
+		std::string name;
+		while ( name.size() < 10 && pos < end && *pos != ';' && *pos != '<' && !IsSpace(*pos) )
+		{
+			name += *pos++;
+		}
+
+		if ( pos == end || *pos != ';' || !AppendEntity(out, name) )
+		{
+			out += '&';
+			out += name;
+			return;
+		}
+
+		++pos;
+	}
+}
+
+XmlReader::XmlReader(std::istream& is, const std::string& fileName) : Buf_(is.rdbuf()), FileName_(fileName)
+{
+	//UTF-8 BOM
+	if ( Peek() == 0xEF )
+	{
+		Get();
+		Expect(static_cast<char>(0xBB));
+		Expect(static_cast<char>(0xBF));
+	}
+}
+
+int XmlReader::Get()
+{
+	auto ch = Buf_->sbumpc();
+	if ( ch == '\n' )
+	{
+		++Line_;
+	}
+	return ch;
+}
+
+void XmlReader::Fail(const std::string& message) const
+{
+	throw xml_parser_error(message, FileName_, static_cast<unsigned long>(Line_));
+}
+
+void XmlReader::Expect(char ch)
+{
+	if ( Get() != static_cast<unsigned char>(ch) )
+	{
+		Fail(std::string("expected '") + ch + "'");
+	}
+}
+
+void XmlReader::SkipSpace()
+{
+	while ( IsSpace(Peek()) )
+	{
+		Get();
+	}
+}
+
+void XmlReader::SkipUntil(const char* terminator)
+{
+	auto length = std::strlen(terminator);
+	std::string window;
+	while ( window.size() < length || window.compare(window.size() - length, length, terminator) != 0 )
+	{
+		auto ch = Get();
+		if ( ch == std::char_traits<char>::eof() )
+		{
+			Fail("unexpected end of data");
+		}
+		window += static_cast<char>(ch);
+		if ( window.size() > length )
+		{
+			window.erase(0, 1);
+		}
+	}
+}
+
+void XmlReader::SkipDocType()
+{
+	auto depth = 0;
+	for ( ;; )
+	{
+		auto ch = Get();
+		if ( ch == std::char_traits<char>::eof() )
+		{
+			Fail("unexpected end of data");
+		}
+		else if ( ch == '[' )
+		{
+			++depth;
+		}
+		else if ( ch == ']' )
+		{
+			--depth;
+		}
+		else if ( ch == '>' && depth == 0 )
+		{
+			return;
+		}
+	}
+}
+
+void XmlReader::ReadName(std::string& name)
+{
+	name.clear();
+	for ( ;; )
+	{
+		auto ch = Peek();
+		if ( ch == std::char_traits<char>::eof() || IsSpace(ch) || ch == '/' || ch == '>' || ch == '=' )
+		{
+			break;
+		}
+		name += static_cast<char>(Get());
+	}
+
+	if ( name.empty() )
+	{
+		Fail("expected element or attribute name");
+	}
+}
+
+void XmlReader::ReadEntity(std::string& out)
+{
+	//'&' has been read. Unknown references are kept as they are, like rapidxml does.
+	std::string name;
+	while ( name.size() < 10 && Peek() != ';' && Peek() != '<' && Peek() != std::char_traits<char>::eof() && !IsSpace(Peek()) )
+	{
+		name += static_cast<char>(Get());
+	}
+
+	if ( Peek() != ';' || !AppendEntity(out, name) )
+	{
+		out += '&';
+		out += name;
+		return;
+	}
+
+	Get();
+}
+
+void XmlReader::ReadStartTag()
+{
+	ReadName(Name_);
+	Attributes_.clear();
+	EmptyElement_ = false;
+
+	for ( ;; )
+	{
+		SkipSpace();
+
+		auto ch = Peek();
+		if ( ch == '/' )
+		{
+			Get();
+			Expect('>');
+			EmptyElement_ = true;
+			return;
+		}
+		else if ( ch == '>' )
+		{
+			Get();
+			return;
+		}
+
+		std::string attrName, attrValue;
+		ReadName(attrName);
+		SkipSpace();
+		Expect('=');
+		SkipSpace();
+
+		auto quote = Get();
+		if ( quote != '"' && quote != '\'' )
+		{
+			Fail("expected quoted attribute value");
+		}
+
+		for ( ;; )
+		{
+			ch = Get();
+			if ( ch == std::char_traits<char>::eof() )
+			{
+				Fail("unexpected end of data");
+			}
+			else if ( ch == quote )
+			{
+				break;
+			}
+			else if ( ch == '&' )
+			{
+				ReadEntity(attrValue);
+			}
+			else
+			{
+				attrValue += static_cast<char>(ch);
+			}
+		}
+
+		Attributes_.push_back(std::make_pair(attrName, ptree(attrValue)));
+	}
+}
+
+void XmlReader::ReadEndTag()
+{
+	std::string name;
+	ReadName(name);
+	SkipSpace();
+	Expect('>');
+
+	if ( Stack_.empty() || Stack_.back() != name )
+	{
+		Fail("unexpected end tag </" + name + ">");
+	}
+	Stack_.pop_back();
+}
+
+void XmlReader::ReadText()
+{
+	//Leading and trailing whitespace is dropped and inner runs are folded to one space.
+	Text_.clear();
+	auto pendingSpace = false;
+	for ( ;; )
+	{
+		auto ch = Peek();
+		if ( ch == std::char_traits<char>::eof() || ch == '<' )
+		{
+			break;
+		}
+
+		Get();
+		if ( IsSpace(ch) )
+		{
+			pendingSpace = !Text_.empty();
+			continue;
+		}
+
+		if ( pendingSpace )
+		{
+			Text_ += ' ';
+			pendingSpace = false;
+		}
+
+		if ( ch == '&' )
+		{
+			ReadEntity(Text_);
+		}
+		else
+		{
+			Text_ += static_cast<char>(ch);
+		}
+	}
+
+	//A trailing space produced by a character reference is trimmed as well.
+	if ( !Text_.empty() && Text_.back() == ' ' )
+	{
+		Text_.pop_back();
+	}
+}
+
+void XmlReader::ReadCData()
+{
+	//"<![" has been read.
+	for ( auto ch : std::string("CDATA[") )
+	{
+		Expect(ch);
+	}
+
+	Text_.clear();
+	while ( Text_.size() < 3 || Text_.compare(Text_.size() - 3, 3, "]]>") != 0 )
+	{
+		auto ch = Get();
+		if ( ch == std::char_traits<char>::eof() )
+		{
+			Fail("unexpected end of data");
+		}
+		Text_ += static_cast<char>(ch);
+	}
+	Text_.erase(Text_.size() - 3);
+}
+
+XmlReader::EToken XmlReader::ReadToken()
+{
+	if ( PendingEnd_ )
+	{
+		PendingEnd_ = false;
+		Stack_.pop_back();
+		return EToken::EndElement;
+	}
+
+	for ( ;; )
+	{
+		auto ch = Peek();
+		if ( ch == std::char_traits<char>::eof() )
+		{
+			return EToken::End;
+		}
+
+		if ( ch != '<' )
+		{
+			ReadText();
+			if ( Text_.empty() )
+			{
+				continue;
+			}
+			return EToken::Text;
+		}
+
+		Get();
+		ch = Peek();
+		if ( ch == '?' )
+		{
+			SkipUntil("?>");
+		}
+		else if ( ch == '!' )
+		{
+			Get();
+			if ( Peek() == '-' )
+			{
+				Get();
+				Expect('-');
+				SkipUntil("-->");
+			}
+			else if ( Peek() == '[' )
+			{
+				Get();
+				ReadCData();
+				if ( !Text_.empty() )
+				{
+					return EToken::Text;
+				}
+			}
+			else
+			{
+				SkipDocType();
+			}
+		}
+		else if ( ch == '/' )
+		{
+			Get();
+			ReadEndTag();
+			return EToken::EndElement;
+		}
+		else
+		{
+			ReadStartTag();
+			Stack_.push_back(Name_);
+			PendingEnd_ = EmptyElement_;
+			return EToken::StartElement;
+		}
+	}
+}
+
+bool XmlReader::NextChild()
+{
+	for ( ;; )
+	{
+		switch ( ReadToken() )
+		{
+		case EToken::StartElement:
+			return true;
+		case EToken::EndElement:
+			return false;
+		case EToken::Text:
+			break;
+		case EToken::End:
+			if ( !Stack_.empty() )
+			{
+				Fail("unexpected end of data");
+			}
+			return false;
+		}
+	}
+}
+
+void XmlReader::ReadElement(ptree& element)
+{
+	if ( !Attributes_.empty() )
+	{
+		element.push_back(std::make_pair("<xmlattr>", Attributes_));
+	}
+
+	for ( ;; )
+	{
+		switch ( ReadToken() )
+		{
+		case EToken::StartElement:
+			ReadElement(element.push_back(std::make_pair(Name_, ptree()))->second);
+			break;
+		case EToken::EndElement:
+			return;
+		case EToken::Text:
+			element.data() += Text_;
+			break;
+		case EToken::End:
+			Fail("unexpected end of data");
+		}
+	}
+}
+
+void XmlReader::SkipElement()
+{
+	size_t depth = 1;
+	while ( depth > 0 )
+	{
+		switch ( ReadToken() )
+		{
+		case EToken::StartElement:
+			++depth;
+			break;
+		case EToken::EndElement:
+			--depth;
+			break;
+		case EToken::Text:
+			break;
+		case EToken::End:
+			Fail("unexpected end of data");
+		}
+	}
+}
+
+XmlWriter::XmlWriter(std::ostream& os, int indentCount) : Os_(os), IndentCount_(indentCount)
+{
+}
+
+void XmlWriter::WriteDeclaration()
+{
+	Os_ << "<?xml version=\"1.0\" encoding=\"utf-8\"?>\n";
+}
+
+void XmlWriter::WriteIndent(size_t depth)
+{
+	Os_ << std::string(depth * IndentCount_, ' ');
+}
+
+void XmlWriter::WriteStartTag(const SOpenElement& element, bool empty)
+{
+	Os_ << '<' << element.Name_;
+	for ( auto& curAttr : element.Attributes_ )
+	{
+		Os_ << ' ' << curAttr.first << "=\"" << xml_parser::encode_char_entities(curAttr.second.data()) << '"';
+	}
+	Os_ << (empty ? "/>\n" : ">\n");
+}
+
+void XmlWriter::Flush()
+{
+	for ( size_t depth = 0; depth < Stack_.size(); ++depth )
+	{
+		if ( !Stack_[depth].Written_ )
+		{
+			WriteIndent(depth);
+			WriteStartTag(Stack_[depth], false);
+			Stack_[depth].Written_ = true;
+		}
+	}
+}
+
+void XmlWriter::StartElement(const std::string& name, const ptree& attributes)
+{
+	Flush();
+
+	SOpenElement element;
+	element.Name_ = name;
+	element.Attributes_ = attributes;
+	Stack_.push_back(element);
+}
+
+void XmlWriter::WriteElement(const std::string& name, const ptree& element)
+{
+	Flush();
+
+	//The element writer behind write_xml, so streamed output matches the DOM output.
+	auto settings = xml_writer_settings<std::string>(' ', IndentCount_);
+	xml_parser::write_xml_element(Os_, name, element, static_cast<int>(Stack_.size()), settings);
+}
+
+void XmlWriter::EndElement()
+{
+	auto& element = Stack_.back();
+	WriteIndent(Stack_.size() - 1);
+	if ( element.Written_ )
+	{
+		Os_ << "</" << element.Name_ << ">\n";
+	}
+	else
+	{
+		WriteStartTag(element, true);
+	}
+	Stack_.pop_back();
+}
+
+const XmlDocument::SNode* XmlDocument::SNode::GetChild(const char* name) const
+{
+	for ( auto curChild = FirstChild_; curChild; curChild = curChild->Next_ )
+	{
+		if ( curChild->Name_ == name )
+		{
+			return curChild;
+		}
+	}
+
+	return nullptr;
+}
+
+boost::optional<std::string> XmlDocument::SNode::GetAttribute(const char* name) const
+{
+	for ( auto curAttr = FirstAttribute_; curAttr; curAttr = curAttr->Next_ )
+	{
+		if ( curAttr->Name_ == name )
+		{
+			return curAttr->Value_.str();
+		}
+	}
+
+	return boost::none;
+}
+
+boost::optional<std::string> XmlDocument::SNode::GetAttribute(const char* childName, const char* name) const
+{
+	auto child = GetChild(childName);
+	if ( !child )
+	{
+		return boost::none;
+	}
+
+	return child->GetAttribute(name);
+}
+
+void* XmlDocument::Allocate(size_t size)
+{
+	const size_t blockSize = 64 * 1024;
+	const size_t alignment = 8;
+
+	size = (size + alignment - 1) & ~(alignment - 1);
+	if ( size > BlockLeft_ )
+	{
+		//Large strings get a block of their own so the current block keeps its space.
+		if ( size > blockSize / 4 )
+		{
+			Blocks_.emplace_back(new char[size]);
+			return Blocks_.back().get();
+		}
+
+		Blocks_.emplace_back(new char[blockSize]);
+		BlockPos_ = Blocks_.back().get();
+		BlockLeft_ = blockSize;
+	}
+
+	auto ret = BlockPos_;
+	BlockPos_ += size;
+	BlockLeft_ -= size;
+	return ret;
+}
+
+XmlDocument::SStringRef XmlDocument::Store(const std::string& text)
+{
+	SStringRef ret;
+	if ( !text.empty() )
+	{
+		auto data = static_cast<char*>(Allocate(text.size()));
+		std::memcpy(data, text.data(), text.size());
+		ret.Data_ = data;
+		ret.Size_ = text.size();
+	}
+	return ret;
+}
+
+void XmlDocument::Fail(const char* pos, const std::string& message) const
+{
+	auto line = 1 + std::count(File_.GetData(), pos, '\n');
+	throw xml_parser_error(message, FileName_, static_cast<unsigned long>(line));
+}
+
+const char* XmlDocument::SkipPast(const char* pos, const char* terminator)
+{
+	auto end = File_.GetData() + File_.GetSize();
+	auto length = std::strlen(terminator);
+
+	auto found = std::search(pos, end, terminator, terminator + length);
+	if ( found == end )
+	{
+		Fail(end, "unexpected end of data");
+	}
+	return found + length;
+}
+
+XmlDocument::SStringRef XmlDocument::ReadName(const char*& pos)
+{
+	auto end = File_.GetData() + File_.GetSize();
+
+	SStringRef ret;
+	ret.Data_ = pos;
+	while ( pos < end && !IsSpace(*pos) && *pos != '/' && *pos != '>' && *pos != '=' )
+	{
+		++pos;
+	}
+	ret.Size_ = pos - ret.Data_;
+
+	if ( ret.Size_ == 0 )
+	{
+		Fail(pos, "expected element or attribute name");
+	}
+	return ret;
+}
+
+XmlDocument::SStringRef XmlDocument::ReadAttributeValue(const char*& pos)
+{
+	auto end = File_.GetData() + File_.GetSize();
+
+	auto quote = pos < end ? *pos : 0;
+	if ( quote != '"' && quote != '\'' )
+	{
+		Fail(pos, "expected quoted attribute value");
+	}
+
+	auto begin = ++pos;
+	auto close = std::find(begin, end, quote);
+	if ( close == end )
+	{
+		Fail(end, "unexpected end of data");
+	}
+	pos = close + 1;
+
+	SStringRef ret;
+	ret.Data_ = begin;
+	ret.Size_ = close - begin;
+	if ( std::find(begin, close, '&') == close )
+	{
+		return ret;
+	}
+
+	std::string decoded;
+	for ( auto cur = begin; cur < close; )
+	{
+		auto ch = *cur++;
+		if ( ch == '&' )
+		{
+			DecodeEntity(cur, close, decoded);
+		}
+		else
+		{
+			decoded += ch;
+		}
+	}
+	return Store(decoded);
+}
+
+void XmlDocument::AppendValue(SNode& node, const SStringRef& text)
+{
+	if ( text.Size_ == 0 )
+	{
+		return;
+	}
+
+	if ( node.Value_.Size_ == 0 )
+	{
+		node.Value_ = text;
+		return;
+	}
+
+	//Text around a child element or a CDATA section is concatenated, as ReadElement does.
+	node.Value_ = Store(node.Value_.str() + text.str());
+}
+
+void XmlDocument::AddText(SNode& node, const char* begin, const char* end)
+{
+	//Trimmed like XmlReader::ReadText. Text that is already in that form is used in place.
+	while ( begin < end && IsSpace(*begin) )
+	{
+		++begin;
+	}
+	while ( end > begin && IsSpace(end[-1]) )
+	{
+		--end;
+	}
+	if ( begin == end )
+	{
+		return;
+	}
+
+	auto clean = true;
+	for ( auto cur = begin; cur < end && clean; ++cur )
+	{
+		clean = *cur != '&' && (!IsSpace(*cur) || (*cur == ' ' && !IsSpace(cur[1])));
+	}
+
+	if ( clean )
+	{
+		SStringRef text;
+		text.Data_ = begin;
+		text.Size_ = end - begin;
+		AppendValue(node, text);
+		return;
+	}
+
+	std::string folded;
+	auto pendingSpace = false;
+	for ( auto cur = begin; cur < end; )
+	{
+		auto ch = *cur++;
+		if ( IsSpace(ch) )
+		{
+			pendingSpace = !folded.empty();
+			continue;
+		}
+
+		if ( pendingSpace )
+		{
+			folded += ' ';
+			pendingSpace = false;
+		}
+
+		if ( ch == '&' )
+		{
+			DecodeEntity(cur, end, folded);
+		}
+		else
+		{
+			folded += ch;
+		}
+	}
+
+	if ( !folded.empty() && folded.back() == ' ' )
+	{
+		folded.pop_back();
+	}
+	AppendValue(node, Store(folded));
+}
+
+void XmlDocument::Load(const bfs::path& file)
+{
+	FileName_ = file.string();
+	if ( !File_.Open(file) )
+	{
+		throw xml_parser_error("cannot open file", FileName_, 0);
+	}
+
+	Parse();
+}
+
+void XmlDocument::Parse()
+{
+	auto pos = File_.GetData();
+	auto end = pos + File_.GetSize();
+
+	//UTF-8 BOM
+	if ( end - pos >= 3 && std::memcmp(pos, "\xEF\xBB\xBF", 3) == 0 )
+	{
+		pos += 3;
+	}
+
+	//Open elements, with the last child added to each so siblings are linked in order.
+	std::vector<std::pair<SNode*, SNode*>> stack;
+	stack.push_back(std::make_pair(&Root_, nullptr));
+
+	while ( pos < end )
+	{
+		if ( *pos != '<' )
+		{
+			auto textEnd = std::find(pos, end, '<');
+			AddText(*stack.back().first, pos, textEnd);
+			pos = textEnd;
+			continue;
+		}
+
+		++pos;
+		if ( pos < end && *pos == '?' )
+		{
+			pos = SkipPast(pos, "?>");
+		}
+		else if ( end - pos >= 3 && std::memcmp(pos, "!--", 3) == 0 )
+		{
+			pos = SkipPast(pos + 3, "-->");
+		}
+		else if ( end - pos >= 8 && std::memcmp(pos, "![CDATA[", 8) == 0 )
+		{
+			SStringRef text;
+			text.Data_ = pos + 8;
+			pos = SkipPast(pos + 8, "]]>");
+			text.Size_ = pos - 3 - text.Data_;
+			AppendValue(*stack.back().first, text);
+		}
+		else if ( pos < end && *pos == '!' )
+		{
+			auto depth = 0;
+			for ( ++pos; pos < end && (*pos != '>' || depth > 0); ++pos )
+			{
+				depth += *pos == '[' ? 1 : (*pos == ']' ? -1 : 0);
+			}
+			if ( pos == end )
+			{
+				Fail(end, "unexpected end of data");
+			}
+			++pos;
+		}
+		else if ( pos < end && *pos == '/' )
+		{
+			++pos;
+			auto name = ReadName(pos);
+			while ( pos < end && IsSpace(*pos) )
+			{
+				++pos;
+			}
+			if ( pos == end || *pos != '>' )
+			{
+				Fail(pos, "expected '>'");
+			}
+			++pos;
+
+			auto& open = stack.back().first->Name_;
+			if ( stack.size() == 1 || name.Size_ != open.Size_ || std::memcmp(name.Data_, open.Data_, name.Size_) != 0 )
+			{
+				Fail(pos, "unexpected end tag </" + name.str() + ">");
+			}
+			stack.pop_back();
+		}
+		else
+		{
+			auto node = New<SNode>();
+			node->Name_ = ReadName(pos);
+
+			auto& parent = stack.back();
+			if ( parent.second )
+			{
+				parent.second->Next_ = node;
+			}
+			else
+			{
+				parent.first->FirstChild_ = node;
+			}
+			parent.second = node;
+
+			SAttribute* lastAttr = nullptr;
+			auto empty = false;
+			for ( ;; )
+			{
+				while ( pos < end && IsSpace(*pos) )
+				{
+					++pos;
+				}
+				if ( pos == end )
+				{
+					Fail(end, "unexpected end of data");
+				}
+
+				if ( *pos == '/' )
+				{
+					if ( ++pos == end || *pos != '>' )
+					{
+						Fail(pos, "expected '>'");
+					}
+					++pos;
+					empty = true;
+					break;
+				}
+				else if ( *pos == '>' )
+				{
+					++pos;
+					break;
+				}
+
+				auto attr = New<SAttribute>();
+				attr->Name_ = ReadName(pos);
+				while ( pos < end && IsSpace(*pos) )
+				{
+					++pos;
+				}
+				if ( pos == end || *pos != '=' )
+				{
+					Fail(pos, "expected '='");
+				}
+				++pos;
+				while ( pos < end && IsSpace(*pos) )
+				{
+					++pos;
+				}
+				attr->Value_ = ReadAttributeValue(pos);
+
+				if ( lastAttr )
+				{
+					lastAttr->Next_ = attr;
+				}
+				else
+				{
+					node->FirstAttribute_ = attr;
+				}
+				lastAttr = attr;
+			}
+
+			if ( !empty )
+			{
+				stack.push_back(std::make_pair(node, nullptr));
+			}
+		}
+	}
+
+	if ( stack.size() > 1 )
+	{
+		Fail(end, "unexpected end of data");
+	}
+}
@@ -0,0 +1,191 @@
+#pragma once
+
+#include "MappedFile.h"
+
+#include <boost/optional.hpp>
+#include <boost/property_tree/ptree.hpp>
+
+#include <cstring>
+#include <istream>
+#include <memory>
+#include <new>
+#include <ostream>
+#include <string>
+#include <vector>
+
+//Pull reader for the project files. Only the element being looked at is kept in memory, so
+//a transformer can visit a .vcxproj item by item instead of loading the whole document.
+//Text is handled like read_xml with no_comments | trim_whitespace.
+class	XmlReader
+{
+public:
+
+	//fileName is only used in error messages.
+	explicit	XmlReader(std::istream& is, const std::string& fileName = std::string());
+
+	//Moves to the next child element of the current element and enters it. Returns false,
+	//leaving the current element, once its end tag is reached.
+	bool		NextChild();
+
+	//Name and attributes of the element entered by the last NextChild.
+	const std::string&	GetName() const { return Name_; }
+	const boost::property_tree::ptree&	GetAttributes() const { return Attributes_; }
+
+	//Reads the rest of the element entered by the last NextChild, up to and including its end
+	//tag, in the same layout read_xml produces ("<xmlattr>" child, text as value).
+	void		ReadElement(boost::property_tree::ptree& element);
+
+	//Like ReadElement, but throws the element away.
+	void		SkipElement();
+
+private:
+
+	enum class	EToken
+	{
+		StartElement,
+		EndElement,
+		Text,
+		End,
+	};
+
+	EToken		ReadToken();
+	void		ReadStartTag();
+	void		ReadEndTag();
+	void		ReadText();
+	void		ReadCData();
+	void		SkipUntil(const char* terminator);
+	void		SkipDocType();
+	void		ReadName(std::string& name);
+	void		ReadEntity(std::string& out);
+	void		SkipSpace();
+	void		Expect(char ch);
+	void		Fail(const std::string& message) const;
+
+	int			Peek() { return Buf_->sgetc(); }
+	int			Get();
+
+	std::streambuf*	Buf_;
+	std::string	FileName_;
+	size_t		Line_ = 1;
+
+	std::string	Name_;
+	boost::property_tree::ptree	Attributes_;
+	std::string	Text_;
+	bool		EmptyElement_ = false;
+	bool		PendingEnd_ = false;
+	std::vector<std::string>	Stack_;
+};
+
+//Writes elements in the same format as write_xml. Container elements are opened with
+//StartElement and closed with EndElement; an element that got no children is written as
+//an empty element, as write_xml would.
+class	XmlWriter
+{
+public:
+
+	XmlWriter(std::ostream& os, int indentCount);
+
+	void		WriteDeclaration();
+	void		StartElement(const std::string& name, const boost::property_tree::ptree& attributes);
+	void		WriteElement(const std::string& name, const boost::property_tree::ptree& element);
+	void		EndElement();
+
+private:
+
+	class	SOpenElement
+	{
+	public:
+		std::string	Name_;
+		boost::property_tree::ptree	Attributes_;
+		bool		Written_ = false;
+	};
+
+	void		WriteIndent(size_t depth);
+	void		WriteStartTag(const SOpenElement& element, bool empty);
+	void		Flush();
+
+	std::ostream&	Os_;
+	int			IndentCount_;
+	std::vector<SOpenElement>	Stack_;
+};
+
+//Whole-document reader for the files that are looked up rather than transformed (config.xml,
+//the project references). The file is memory-mapped and parsed once into a read-only tree:
+//names and values point into the mapping, or into the document's arena when entities or
+//whitespace had to be rewritten, and every node comes from that arena. Text is handled like
+//XmlReader does.
+class	XmlDocument
+{
+public:
+
+	class	SStringRef
+	{
+	public:
+		const char*	Data_ = nullptr;
+		size_t		Size_ = 0;
+
+		std::string	str() const { return std::string(Data_, Size_); }
+		bool		operator==(const char* text) const { return std::strlen(text) == Size_ && std::memcmp(Data_, text, Size_) == 0; }
+		bool		operator!=(const char* text) const { return !(*this == text); }
+	};
+
+	class	SAttribute
+	{
+	public:
+		SStringRef	Name_;
+		SStringRef	Value_;
+		const SAttribute*	Next_ = nullptr;
+	};
+
+	class	SNode
+	{
+	public:
+		SStringRef	Name_;
+		SStringRef	Value_;
+		const SAttribute*	FirstAttribute_ = nullptr;
+		const SNode*	FirstChild_ = nullptr;
+		const SNode*	Next_ = nullptr;
+
+		//First child called name, or nullptr.
+		const SNode*	GetChild(const char* name) const;
+
+		boost::optional<std::string>	GetAttribute(const char* name) const;
+
+		//Attribute name of the first child called childName, as get_optional("childName.<xmlattr>.name").
+		boost::optional<std::string>	GetAttribute(const char* childName, const char* name) const;
+	};
+
+	XmlDocument() {}
+
+	//Throws xml_parser_error when the file can not be read or is not well formed.
+	void		Load(const bfs::path& file);
+
+	//The top-level elements are the children of the root.
+	const SNode&	GetRoot() const { return Root_; }
+
+private:
+
+	XmlDocument(const XmlDocument&);
+	XmlDocument&	operator=(const XmlDocument&);
+
+	template<typename T>
+	T*			New() { return new (Allocate(sizeof(T))) T(); }
+	void*		Allocate(size_t size);
+	SStringRef	Store(const std::string& text);
+
+	void		Parse();
+	SStringRef	ReadName(const char*& pos);
+	SStringRef	ReadAttributeValue(const char*& pos);
+	void		AddText(SNode& node, const char* begin, const char* end);
+	void		AppendValue(SNode& node, const SStringRef& text);
+	const char*	SkipPast(const char* pos, const char* terminator);
+	void		Fail(const char* pos, const std::string& message) const;
+
+	MappedFile	File_;
+	std::string	FileName_;
+	SNode		Root_;
+
+	std::vector<std::unique_ptr<char[]>>	Blocks_;
+	char*		BlockPos_ = nullptr;
+	size_t		BlockLeft_ = 0;
+};
@@ -1,14 +1,285 @@
 #include "ProjConvertor.h"
+#include "BuildScheduler.h"
+#include "SolutionFile.h"
+#include "TarWriter.h"
+#include "Watcher.h"
 
-int main()
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <memory>
+
+namespace
+{
+	//Deepest directory every output of the run is written below.
+	bfs::path	CommonOutputRoot(const ProjectList& projList)
+	{
+		std::vector<bfs::path> dirs;
+		for ( auto& curProj : projList )
+		{
+			dirs.push_back(curProj.ProjectBuildPath);
+			dirs.push_back(curProj.VCXProjectPath.To_);
+			for ( auto& curSrcDir : curProj.SrcList )
+			{
+				dirs.push_back(curSrcDir.To_);
+			}
+			for ( auto& curCpy : curProj.AdditionalCopyList )
+			{
+				dirs.push_back(curCpy.To_.parent_path());
+			}
+		}
+
+		auto& paths = PathTable::GetInstance();
+
+		auto common = PathTable::sEmpty;
+		auto first = true;
+		for ( auto& curDir : dirs )
+		{
+			auto dir = paths.Intern(bfs::absolute(curDir));
+			if ( first )
+			{
+				common = dir;
+				first = false;
+				continue;
+			}
+
+			while ( !paths.IsWithin(dir, common) )
+			{
+				common = paths.GetParent(common);
+			}
+		}
+
+		return paths.ToPath(common);
+	}
+}
+
+int main(int argc, char* argv[])
 {
-	auto projList = ReadConfig();
-	
+	unsigned jobs = 0;
+	bfs::path reportPath;
+	std::vector<bfs::path> configPaths;
+	bfs::path slnPath, slnOutPath;
+	bfs::path gcStorePath;
+	bfs::path archivePath, archiveRoot;
+	auto dryRun = false;
+	auto watch = false;
+	auto rebuild = false;
+
+	for ( int index = 1; index < argc; ++index )
+	{
+		if ( (std::strcmp(argv[index], "-j") == 0 || std::strcmp(argv[index], "--jobs") == 0) && index + 1 < argc )
+		{
+			jobs = static_cast<unsigned>(std::atoi(argv[++index]));
+		}
+		else if ( std::strcmp(argv[index], "--dry-run") == 0 )
+		{
+			dryRun = true;
+		}
+		else if ( std::strcmp(argv[index], "--watch") == 0 )
+		{
+			watch = true;
+		}
+		else if ( std::strcmp(argv[index], "--rebuild") == 0 )
+		{
+			rebuild = true;
+		}
+		else if ( std::strcmp(argv[index], "--report") == 0 && index + 1 < argc )
+		{
+			reportPath = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--config") == 0 && index + 1 < argc )
+		{
+			configPaths.push_back(argv[++index]);
+		}
+		else if ( std::strcmp(argv[index], "--sln") == 0 && index + 1 < argc )
+		{
+			slnPath = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--sln-out") == 0 && index + 1 < argc )
+		{
+			slnOutPath = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--archive") == 0 && index + 1 < argc )
+		{
+			archivePath = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--archive-root") == 0 && index + 1 < argc )
+		{
+			archiveRoot = argv[++index];
+		}
+		else if ( std::strcmp(argv[index], "--gc-store") == 0 && index + 1 < argc )
+		{
+			gcStorePath = argv[++index];
+		}
+		else
+		{
+			std::cerr << "Unknown option " << argv[index] << std::endl;
+			std::cerr << "Usage: ProjConvertor [--config FILE]... [--sln FILE] [--sln-out FILE] [--jobs N] [--dry-run | --watch | --archive FILE [--archive-root DIR]] [--rebuild] [--report FILE]" << std::endl;
+			std::cerr << "       ProjConvertor --gc-store DIR" << std::endl;
+			return 1;
+		}
+	}
+
+	//Only collects the store: objects no converted tree links to any more are removed.
+	if ( !gcStorePath.empty() )
+	{
+		std::uintmax_t bytes = 0;
+		auto removed = ContentStore::Collect(gcStorePath, bytes);
+		std::cout << "Removed " << removed << " unused objects, " << bytes << " bytes." << std::endl;
+		return 0;
+	}
+
+	if ( dryRun && watch )
+	{
+		std::cerr << "--dry-run and --watch can not be used together." << std::endl;
+		return 1;
+	}
+
+	if ( !archivePath.empty() && (dryRun || watch) )
+	{
+		std::cerr << "--archive can not be used with --dry-run or --watch." << std::endl;
+		return 1;
+	}
+
+	if ( configPaths.empty() )
+	{
+		configPaths.push_back("config.xml");
+	}
+
+	//The rewritten solution goes to the working directory unless told otherwise.
+	if ( !slnPath.empty() && slnOutPath.empty() )
+	{
+		slnOutPath = slnPath.filename();
+	}
+	boost::system::error_code ec;
+	if ( !slnPath.empty() && bfs::equivalent(slnPath, slnOutPath, ec) )
+	{
+		std::cerr << "--sln-out would overwrite " << slnPath << std::endl;
+		return 1;
+	}
+
+	//Only timed and counted when a JSON report was asked for.
+	std::unique_ptr<RunReport> report;
+	if ( !reportPath.empty() )
+	{
+		report.reset(new RunReport);
+		report->SetJobCount(jobs);
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	ProjectList projList;
+	for ( auto& curPath : configPaths )
+	{
+		auto curList = ReadConfig(curPath);
+		projList.insert(projList.end(), curList.begin(), curList.end());
+	}
+
+	if ( !slnPath.empty() && !FilterBySolution(slnPath, projList) )
+	{
+		return 1;
+	}
+
+	if ( report )
+	{
+		report->SetReadConfigSeconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+	}
+
+	//Files listed by several projects are materialized once for the whole run.
+	SharedCopyCache sharedCopies;
+
+	//Extracting the archive in its root gives the tree the normal run writes.
+	std::unique_ptr<TarWriter> archive;
+	if ( !archivePath.empty() )
+	{
+		auto extension = archivePath.extension().string();
+		auto gzip = extension == ".gz" || extension == ".tgz";
+
+		if ( archiveRoot.empty() )
+		{
+			archiveRoot = CommonOutputRoot(projList);
+		}
+
+		archive.reset(new TarWriter);
+		if ( !archive->Open(archivePath, archiveRoot, gzip) )
+		{
+			return 1;
+		}
+	}
+
+	//Projects converted at once share the cores instead of each starting a copy thread per core.
+	//Watch mode reruns them one at a time, with the Jobs they were configured with.
+	auto copyJobShare = GetCopyJobShare(jobs, projList.size());
+	std::vector<unsigned> configuredCopyJobs;
+
 	for ( auto& curProj : projList )
 	{
-		if ( !BuildProject(curProj) )
+		configuredCopyJobs.push_back(curProj.CopyJobs);
+		if ( curProj.CopyJobs == 0 )
+		{
+			curProj.CopyJobs = copyJobShare;
+		}
+
+		curProj.DryRun = dryRun;
+		curProj.SharedCopies = &sharedCopies;
+		curProj.Archive = archive.get();
+
+		//Watch mode reruns whole projects when their .vcxproj changes; the manifest keeps
+		//those reruns to the files that actually changed.
+		curProj.IncrementalCopy = curProj.IncrementalCopy || watch;
+
+		//A normal run skips projects whose fingerprint still matches; --rebuild converts them
+		//all. Watch mode needs every resolution table filled.
+		curProj.UseFingerprint = !dryRun && !watch && !archive;
+		curProj.Rebuild = rebuild;
+		if ( report )
+		{
+			curProj.Report = report->AddProject(curProj.TargetName);
+		}
+	}
+
+	std::vector<ResolutionTable> tables;
+	auto succeeded = BuildProjects(projList, jobs, watch ? &tables : nullptr);
+
+	if ( archive )
+	{
+		succeeded = archive->Close() && succeeded;
+		if ( succeeded )
 		{
-			return 0;
+			std::cout << "Archive written to " << archivePath << ", extract it in " << archiveRoot << std::endl;
 		}
-	}	
+	}
+
+	if ( succeeded && !dryRun && !slnOutPath.empty() )
+	{
+		succeeded = slnPath.empty() ? WriteSolution(slnOutPath, projList) : RewriteSolution(slnPath, slnOutPath, projList);
+		if ( succeeded )
+		{
+			std::cout << "Solution written to " << slnOutPath << std::endl;
+		}
+	}
+
+	if ( report )
+	{
+		report->SetTotalSeconds(std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+		if ( !report->Write(reportPath) )
+		{
+			return 1;
+		}
+	}
+
+	if ( watch )
+	{
+		//A changed file has to be written again even though this run already wrote it.
+		for ( size_t index = 0; index < projList.size(); ++index )
+		{
+			projList[index].SharedCopies = nullptr;
+			projList[index].CopyJobs = configuredCopyJobs[index];
+		}
+
+		return WatchProjects(projList, tables) ? 0 : 1;
+	}
+
+	return succeeded ? 0 : 1;
 }
\ No newline at end of file